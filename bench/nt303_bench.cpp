@@ -0,0 +1,823 @@
+/*
+ * NT-303 host benchmark
+ *
+ * Links the plugin against a stub of the disting NT API and drives it through its factory
+ * (construct, parameterChanged, midiMessage, step) with scripted note patterns. For every
+ * scenario, oversampling factor and anti-aliasing mode it prints one JSON line with the
+ * best-of-N time per sample and how many instances would fit into one core of this machine in
+ * real time.
+ *
+ * With "budget" as the first argument it prints the memory and cycle budget of one instance
+ * instead and exits non-zero when any of it is over the given limits (run by `make check`). A
+ * limit of "-" only reports the value; the host cycle limits are "-" unless given to make, while
+ * the cycles as a percentage of a reference loop timed in the same run are held to a default.
+ *
+ * "arena" checks the DRAM arena (src/nt_heap.h) on its own: size-class reuse, the bound on
+ * wasted space, failure handling and the peak/fragmentation counters.
+ *
+ * "fastmath" sweeps rosic::fastExp2() and fastLog2() against libm over the ranges documented in
+ * rosic_FastMath.h, fails when an error exceeds its documented bound and prints ns per call.
+ *
+ * "render" writes the output of the acid line and filter FM scenarios at every oversampling
+ * factor to a file; "precision" renders the same and compares it against such a file from the
+ * other precision, failing when the SNR of any render is below the given limit. `make check`
+ * renders with the double build and compares the single one against it.
+ *
+ * Usage: nt_303_bench [seconds per run] [runs]   (built and run by `make bench`)
+ *        nt_303_bench budget <sram> <voice> <dram> <cycles 1x> <cycles 2x> <cycles 4x>
+ *                            <percent 1x> <percent 2x> <percent 4x>
+ *        nt_303_bench arena
+ *        nt_303_bench fastmath
+ *        nt_303_bench render <file>
+ *        nt_303_bench precision <file> <min SNR dB>
+ */
+
+#include <distingnt/api.h>
+#include "nt_heap.h"
+#include "rosic_Open303.h"
+#include "rosic_FastMath.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef BENCH_REVISION
+#define BENCH_REVISION "unknown"
+#endif
+
+#ifdef OPEN303_SINGLE_PRECISION
+#define BENCH_PRECISION "single"
+#else
+#define BENCH_PRECISION "double"
+#endif
+
+namespace {
+    constexpr uint32_t kSampleRate = 48000;
+    constexpr int kBlockFrames = 128;
+    constexpr int kNumBusses = 28;
+    constexpr int kOutputBus = 13;
+    constexpr int kModulationBus = 1;       // Cutoff CV in the filterfm scenario
+    constexpr float kModulationHz = 375.0f; // one period per block, so the bus is written once
+
+    uint32_t nowCycles() {
+        using namespace std::chrono;
+        return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Host cycles for the budget: the time stamp counter where there is one, nanoseconds otherwise.
+    uint64_t hostCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __builtin_ia32_rdtsc();
+#else
+        using namespace std::chrono;
+        return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+}
+
+// ---- Stub API ----
+
+// With the clock stopped every MIDI message lands on the first frame of the next block, so
+// renders do not depend on timing.
+static bool frozenClock = false;
+
+const _NT_globals NT_globals = { kSampleRate, kBlockFrames, nullptr, 0 };
+
+extern "C" {
+void NT_drawText(int, int, const char*, int, _NT_textAlignment, _NT_textSize) {}
+int NT_intToString(char* buffer, int32_t value) { return sprintf(buffer, "%d", (int)value); }
+void NT_setParameterFromUi(uint32_t, uint32_t, int16_t) {}
+int32_t NT_algorithmIndex(const _NT_algorithm*) { return 0; }
+uint32_t NT_parameterOffset(void) { return 0; }
+uint32_t NT_getCpuCycleCount(void) { return frozenClock ? 0 : nowCycles(); }
+}
+
+uintptr_t pluginEntry(_NT_selector selector, uint32_t data);
+
+// ---- Scenarios ----
+
+// One step of a 16-step acid line: note (-1 = rest), accent, slide into the next step.
+struct AcidStep {
+    int note;
+    bool accent;
+    bool slide;
+};
+
+static const AcidStep acidLine[16] = {
+    { 36, true,  false }, { 36, false, false }, { 48, false, true  }, { 39, false, false },
+    { -1, false, false }, { 36, true,  false }, { 43, false, true  }, { 41, false, false },
+    { 36, false, false }, { -1, false, false }, { 48, true,  true  }, { 46, false, false },
+    { 36, false, false }, { 39, true,  false }, { -1, false, false }, { 34, false, true  },
+};
+
+enum Scenario {
+    kScenarioIdle,      // no notes: the sleeping path
+    kScenarioHeld,      // one note held throughout: the voice never sleeps
+    kScenarioAcid,      // 16th-note line at 130 BPM with accents, slides and rests
+    kScenarioFilterFm,  // the acid line with audio-rate Cutoff CV (a sine of +-1 octave)
+    kNumScenarios
+};
+
+static const char* const scenarioNames[kNumScenarios] = { "idle", "held", "acid", "filterfm" };
+
+struct Instance {
+    const _NT_factory* factory;
+    _NT_algorithm* alg;
+    _NT_algorithmRequirements req;
+    _NT_algorithmMemoryPtrs ptrs;
+    uint32_t numParameters;
+    int16_t v[64];
+};
+
+static int findParameter(const Instance& inst, const char* name) {
+    for (int i = 0; i < (int)inst.numParameters; ++i) {
+        if (!strcmp(inst.alg->parameters[i].name, name))
+            return i;
+    }
+    return -1;
+}
+
+static void setParameter(Instance& inst, const char* name, int16_t value) {
+    int p = findParameter(inst, name);
+    if (p < 0)
+        return;
+    inst.v[p] = value;
+    inst.factory->parameterChanged(inst.alg, p);
+}
+
+// Static memory shared by all instances (the wavetables), set up once like the NT does on load.
+static uint8_t* staticDram = nullptr;
+static uint32_t staticDramSize = 0;
+
+static void initialiseFactory(const _NT_factory* factory) {
+    if (staticDram || !factory->calculateStaticRequirements)
+        return;
+    _NT_staticRequirements req = {};
+    factory->calculateStaticRequirements(req);
+    staticDram = (uint8_t*)calloc(1, req.dram + 16);
+    staticDramSize = req.dram;
+    _NT_staticMemoryPtrs ptrs = { staticDram };
+    factory->initialise(ptrs, req);
+}
+
+static bool createInstance(Instance& inst) {
+    inst.factory = (const _NT_factory*)pluginEntry(kNT_selector_factoryInfo, 0);
+    initialiseFactory(inst.factory);
+
+    int32_t specifications[8] = { 0 };
+    for (uint32_t i = 0; i < inst.factory->numSpecifications && i < 8; ++i)
+        specifications[i] = inst.factory->specifications[i].def;
+
+    _NT_algorithmRequirements& req = inst.req;
+    req = {};
+    inst.factory->calculateRequirements(req, specifications);
+    if (req.numParameters > 64)
+        return false;
+    inst.numParameters = req.numParameters;
+
+    inst.ptrs.sram = (uint8_t*)calloc(1, req.sram);
+    inst.ptrs.dram = (uint8_t*)calloc(1, req.dram + 16);
+    inst.ptrs.dtc = (uint8_t*)calloc(1, req.dtc + 16);
+    inst.ptrs.itc = (uint8_t*)calloc(1, req.itc + 16);
+    inst.alg = inst.factory->construct(inst.ptrs, req, specifications);
+    if (!inst.alg)
+        return false;
+
+    for (uint32_t i = 0; i < req.numParameters; ++i)
+        inst.v[i] = inst.alg->parameters[i].def;
+    inst.alg->v = inst.v;
+    for (uint32_t i = 0; i < req.numParameters; ++i)
+        inst.factory->parameterChanged(inst.alg, i);
+
+    // The instance renders to a bus of its own; no CV inputs.
+    setParameter(inst, "Output", kOutputBus);
+    setParameter(inst, "Output mode", 1);
+    return true;
+}
+
+static void destroyInstance(Instance& inst) {
+    free(inst.ptrs.sram);
+    free(inst.ptrs.dram);
+    free(inst.ptrs.dtc);
+    free(inst.ptrs.itc);
+}
+
+// Sends the MIDI for the frames [start, start + kBlockFrames) of the scenario.
+static void scriptBlock(Instance& inst, Scenario scenario, long start) {
+    const long framesPerStep = kSampleRate * 60 / 130 / 4;
+
+    switch (scenario) {
+        case kScenarioIdle:
+            break;
+
+        case kScenarioHeld:
+            if (start == 0)
+                inst.factory->midiMessage(inst.alg, 0x90, 36, 100);
+            break;
+
+        case kScenarioAcid:
+        case kScenarioFilterFm: {
+            long step = (start + kBlockFrames - 1) / framesPerStep;
+            long stepStart = step * framesPerStep;
+            if (stepStart < start)
+                break;
+            const AcidStep& prev = acidLine[(step + 15) % 16];
+            const AcidStep& curr = acidLine[step % 16];
+            // A slide overlaps the notes, otherwise the previous one ends before the next starts.
+            if (prev.note >= 0 && !prev.slide)
+                inst.factory->midiMessage(inst.alg, 0x80, prev.note, 0);
+            if (curr.note >= 0)
+                inst.factory->midiMessage(inst.alg, 0x90, curr.note, curr.accent ? 127 : 80);
+            if (prev.note >= 0 && prev.slide)
+                inst.factory->midiMessage(inst.alg, 0x80, prev.note, 0);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+// Returns the nanoseconds per sample of the fastest of the runs.
+static double runScenario(Instance& inst, Scenario scenario, int oversamplingIndex,
+                          int antiAliasIndex, double seconds, int runs) {
+    static float busFrames[kNumBusses * kBlockFrames];
+    long numBlocks = (long)(seconds * kSampleRate) / kBlockFrames;
+    double best = 0.0;
+
+    setParameter(inst, "Oversample", oversamplingIndex);
+    setParameter(inst, "Anti-alias", antiAliasIndex);
+
+    // Filter FM runs from the coefficient table, which is what it has a fast path for.
+    bool filterFm = scenario == kScenarioFilterFm;
+    setParameter(inst, "Cutoff CV", filterFm ? kModulationBus : 0);
+    setParameter(inst, "Filter Coefs", filterFm ? 1 : 0);
+
+    for (int run = 0; run < runs; ++run) {
+        inst.factory->midiMessage(inst.alg, 0xB0, 123, 0);
+        memset(busFrames, 0, sizeof(busFrames));
+        float* modulation = busFrames + (kModulationBus - 1) * kBlockFrames;
+        for (int i = 0; filterFm && i < kBlockFrames; ++i)
+            modulation[i] = sinf(6.2831853f * kModulationHz * i / kSampleRate);
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (long b = 0; b < numBlocks; ++b) {
+            scriptBlock(inst, scenario, b * kBlockFrames);
+            inst.factory->step(inst.alg, busFrames, kBlockFrames / 4);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+        ns /= (double)(numBlocks * kBlockFrames);
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+// ---- Budget ----
+
+// Average host cycles per block of the acid line at one oversampling factor, best of the runs.
+static double acidCyclesPerBlock(Instance& inst, int oversamplingIndex, long numBlocks, int runs) {
+    static float busFrames[kNumBusses * kBlockFrames];
+    double best = 0.0;
+
+    setParameter(inst, "Oversample", oversamplingIndex);
+
+    for (int run = 0; run < runs; ++run) {
+        inst.factory->midiMessage(inst.alg, 0xB0, 123, 0);
+        memset(busFrames, 0, sizeof(busFrames));
+
+        uint64_t c0 = hostCycles();
+        for (long b = 0; b < numBlocks; ++b) {
+            scriptBlock(inst, kScenarioAcid, b * kBlockFrames);
+            inst.factory->step(inst.alg, busFrames, kBlockFrames / 4);
+        }
+        double cycles = (double)(hostCycles() - c0) / (double)numBlocks;
+        if (run == 0 || cycles < best)
+            best = cycles;
+    }
+    return best;
+}
+
+// Host cycles of one block of a fixed workload shaped like a voice: an interpolated read from a
+// 32 kB table, a rational clipper and a biquad lowpass, four times over. Dividing the acid line by
+// it cancels most of the host's speed, so the quotient can be held to a limit on any machine.
+static double referenceCycles(long numBlocks) {
+    static float table[8192];
+    static bool tableReady = false;
+    if (!tableReady) {
+        uint32_t seed = 1;
+        for (float& t : table) {
+            seed = seed * 1664525u + 1013904223u;
+            t = (float)(int32_t)seed * (1.0f / 2147483648.0f);
+        }
+        tableReady = true;
+    }
+    const float b0 = 0.0675f, b1 = 0.135f, b2 = 0.0675f, a1 = -1.143f, a2 = 0.4128f;
+    float phase = 0.0f, x1 = 0.0f, x2 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+    volatile float sink;
+
+    uint64_t c0 = hostCycles();
+    for (long b = 0; b < numBlocks; ++b) {
+        for (int i = 0; i < 4 * kBlockFrames; ++i) {
+            int k = (int)phase;
+            float f = phase - (float)k;
+            float x = table[k] + f * (table[k + 1] - table[k]);
+            phase += 37.3f;
+            if (phase >= 8191.0f)
+                phase -= 8191.0f;
+            x = 2.0f * x / (1.0f + fabsf(2.0f * x));
+            float y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+        }
+        sink = y1;
+    }
+    (void)sink;
+    return (double)(hostCycles() - c0) / (double)numBlocks;
+}
+
+// A negative limit only reports the value.
+static bool reportLine(const char* what, double value, double limit, const char* unit) {
+    if (limit < 0.0) {
+        printf("   %-28s %10.0f %-7s (no limit)\n", what, value, unit);
+        return true;
+    }
+    bool ok = value <= limit;
+    printf("%s %-28s %10.0f %-7s (limit %.0f)\n", ok ? "✅" : "❌", what, value, unit, limit);
+    return ok;
+}
+
+// Prints the instance's memory and cycle budget; returns the number of limits exceeded.
+static int runBudget(Instance& inst, int argc, char** argv) {
+    if (argc < 9) {
+        fprintf(stderr, "usage: budget <sram> <voice> <dram> <cycles 1x> <cycles 2x> <cycles 4x> "
+                        "<percent 1x> <percent 2x> <percent 4x>\n");
+        return 1;
+    }
+    double limits[9];
+    for (int i = 0; i < 9; ++i)
+        limits[i] = strcmp(argv[i], "-") ? atof(argv[i]) : -1.0;
+
+    int failures = 0;
+
+    printf("Memory per instance:\n");
+    // The default instance has one voice, which follows the algorithm in its SRAM.
+    failures += !reportLine("sizeof(_NT303Algorithm)", inst.req.sram - sizeof(rosic::Open303), limits[0], "bytes");
+    failures += !reportLine("sizeof(rosic::Open303)", sizeof(rosic::Open303), limits[1], "bytes");
+
+    struct Member {
+        const char* name;
+        size_t size;
+    };
+    const Member members[] = {
+        { "oscillator",       sizeof(rosic::Open303::oscillator) },
+        { "filter",           sizeof(rosic::Open303::filter) },
+        { "ampEnv",           sizeof(rosic::Open303::ampEnv) },
+        { "mainEnv",          sizeof(rosic::Open303::mainEnv) },
+        { "pitchSlewLimiter", sizeof(rosic::Open303::pitchSlewLimiter) },
+        { "ampDeClicker",     sizeof(rosic::Open303::ampDeClicker) },
+        { "rc1, rc2",         2 * sizeof(rosic::Open303::rc1) },
+        { "highpass1, highpass2, allpass", 3 * sizeof(rosic::Open303::highpass1) },
+        { "notch",            sizeof(rosic::Open303::notch) },
+        { "antiAliasFilter",  sizeof(rosic::Open303::antiAliasFilter) },
+        { "decimator",        sizeof(rosic::Open303::decimator) },
+#ifdef OPEN303_USE_SEQUENCER
+        { "sequencer",        sizeof(rosic::Open303::sequencer) },
+#endif
+    };
+    size_t membersTotal = 0;
+    for (const Member& m : members) {
+        printf("     %-31s %7zu bytes\n", m.name, m.size);
+        membersTotal += m.size;
+    }
+    printf("     %-31s %7zu bytes\n", "parameters, state, padding", sizeof(rosic::Open303) - membersTotal);
+
+    // Exercise everything that allocates: the filter table and each oversampling factor.
+    setParameter(inst, "Filter Coefs", 1);
+    for (int o = 0; o < 3; ++o)
+        acidCyclesPerBlock(inst, o, 16, 1);
+    setParameter(inst, "Filter Coefs", 0);
+
+    // initialise() and construct() put their arena at the start of the static and instance DRAM.
+    // Everything the synth allocates comes from them, so the high-water marks are what it uses.
+    const Arena* staticHeap = reinterpret_cast<const Arena*>(staticDram);
+    const Arena* heap = reinterpret_cast<const Arena*>(inst.ptrs.dram);
+    printf("\n");
+    printf("     %-31s %7u bytes (shared by all instances)\n", "static DRAM", staticDramSize);
+    if (staticHeap->size > 0)
+        failures += !reportLine("static DRAM heap high-water", (double)staticHeap->peak,
+                                (double)staticHeap->size, "bytes");
+    printf("     %-31s %7u bytes\n", "requested DRAM", inst.req.dram);
+    failures += !reportLine("DRAM heap high-water", (double)(inst.req.dram - heap->size + heap->peak),
+                            limits[2], "bytes");
+
+    printf("\nHost cycles per %d-frame block (acid line at 130 BPM):\n", kBlockFrames);
+    static const char* const factorNames[] = { "1x oversampling", "2x oversampling", "4x oversampling" };
+    long numBlocks = 2 * kSampleRate / kBlockFrames;
+    // Each run times the reference loop right before the acid line, so both see the same host
+    // load, and the median of the runs' quotients is held to the limit.
+    const int kRuns = 11;
+    double percent[3][kRuns];
+    for (int o = 0; o < 3; ++o) {
+        double best = 0.0;
+        for (int run = 0; run < kRuns; ++run) {
+            double reference = referenceCycles(numBlocks);
+            double cycles = acidCyclesPerBlock(inst, o, numBlocks, 1);
+            if (run == 0 || cycles < best)
+                best = cycles;
+            percent[o][run] = 100.0 * cycles / reference;
+        }
+        failures += !reportLine(factorNames[o], best, limits[3 + o], "cycles");
+    }
+
+    printf("\nMedian percent of a reference loop timed in the same run:\n");
+    for (int o = 0; o < 3; ++o) {
+        std::nth_element(percent[o], percent[o] + kRuns / 2, percent[o] + kRuns);
+        failures += !reportLine(factorNames[o], percent[o][kRuns / 2], limits[6 + o], "%");
+    }
+
+    return failures;
+}
+
+// ---- Arena ----
+
+static bool checkLine(const char* what, bool ok) {
+    printf("%s %s\n", ok ? "✅" : "❌", what);
+    return ok;
+}
+
+static size_t blockOf(const void* ptr) {
+    return reinterpret_cast<const ArenaBlock*>(static_cast<const char*>(ptr) - sizeof(ArenaBlock))->size;
+}
+
+// Runs the arena checks; returns the number that failed.
+static int runArena() {
+    alignas(kArenaAlign) static char memory[65536];
+    Arena a;
+    int failures = 0;
+
+    printf("Size-class reuse:\n");
+    initArena(&a, memory, sizeof(memory));
+    void* p = arenaAlloc(&a, 100);
+    arenaFree(&a, p);
+    size_t top = a.top;
+    failures += !checkLine("a freed block is reused for the same size", arenaAlloc(&a, 100) == p && a.top == top);
+    arenaFree(&a, p);
+    failures += !checkLine("a freed block is reused for a smaller size of the class", arenaAlloc(&a, 90) == p);
+    void* big = arenaAlloc(&a, 200);    // the next class up
+    arenaFree(&a, big);
+    failures += !checkLine("a block of the next class up is reused", arenaAlloc(&a, 100) == big);
+    void* huge = arenaAlloc(&a, 500);   // two classes up
+    arenaFree(&a, huge);
+    top = a.top;
+    void* q = arenaAlloc(&a, 100);
+    failures += !checkLine("a block two classes up is not", q != huge && a.top > top);
+    size_t freeBytes = a.freeBytes;
+    arenaFree(&a, &a);
+    arenaFree(&a, nullptr);
+    failures += !checkLine("free ignores memory that is not from the arena", a.freeBytes == freeBytes);
+
+    // Random sizes, freed in random order: every block must be aligned, inside the arena and
+    // less than four times the block the request needs.
+    printf("\nWaste bound (4096 random requests of 1 to 4096 bytes):\n");
+    initArena(&a, memory, sizeof(memory));
+    void* live[64] = { nullptr };
+    uint32_t seed = 1;
+    bool aligned = true, bounded = true, inside = true;
+    double worst = 0.0;
+    for (int i = 0; i < 4096; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        int slot = (seed >> 8) % 64;
+        if (live[slot]) {
+            arenaFree(&a, live[slot]);
+            live[slot] = nullptr;
+            continue;
+        }
+        size_t size = 1 + (seed >> 16) % 4096;
+        void* ptr = arenaAlloc(&a, size);
+        if (!ptr)
+            continue;
+        live[slot] = ptr;
+        double ratio = (double)blockOf(ptr) / (double)arenaBlockSize(size);
+        worst = ratio > worst ? ratio : worst;
+        aligned &= reinterpret_cast<uintptr_t>(ptr) % kArenaAlign == 0;
+        bounded &= blockOf(ptr) >= arenaBlockSize(size) && ratio < 4.0;
+        inside &= static_cast<char*>(ptr) + size <= memory + sizeof(memory);
+    }
+    failures += !checkLine("every block is aligned", aligned);
+    failures += !checkLine("every block lies inside the arena", inside);
+    failures += !checkLine("no block is four times the size it needs or more", bounded);
+    printf("   worst block / needed size: %.2f\n", worst);
+
+    printf("\nFailure:\n");
+    initArena(&a, memory, 1024);
+    void* small = arenaAlloc(&a, 256);
+    failures += !checkLine("a request that fits succeeds", small != nullptr && !a.failed);
+    failures += !checkLine("a request that does not fit returns nullptr", arenaAlloc(&a, 1024) == nullptr);
+    failures += !checkLine("and marks the arena failed", a.failed && a.numFailures == 1);
+    failures += !checkLine("peak counts the failed request",
+                           a.peak == arenaBlockSize(256) + arenaBlockSize(1024));
+    failures += !checkLine("the arena stays usable", arenaAlloc(&a, 256) != nullptr && a.numAllocs == 2);
+
+    printf("\nCounters:\n");
+    initArena(&a, memory, sizeof(memory));
+    size_t block = arenaBlockSize(100);
+    void* b0 = arenaAlloc(&a, 100);
+    void* b1 = arenaAlloc(&a, 100);
+    void* b2 = arenaAlloc(&a, 100);
+    failures += !checkLine("peak and used follow the allocations", a.peak == 3 * block && a.used == 3 * block);
+    arenaFree(&a, b1);
+    failures += !checkLine("a free moves the block to freeBytes", a.used == 2 * block && a.freeBytes == block);
+    failures += !checkLine("fragmentation is the freed share of the arena",
+                           arenaFragmentation(&a) == (float)block / (float)(3 * block));
+    arenaAlloc(&a, 100);
+    failures += !checkLine("reuse brings fragmentation back to 0", arenaFragmentation(&a) == 0.0f);
+    arenaFree(&a, b0);
+    arenaFree(&a, b2);
+    failures += !checkLine("peak keeps the high-water mark", a.peak == 3 * block && a.used == block);
+    failures += !checkLine("numAllocs counts every successful request", a.numAllocs == 4);
+
+    return failures;
+}
+
+// ---- Fast math ----
+
+// Documented in rosic_FastMath.h.
+constexpr double kExp2MaxRelErrorDouble = 7.5e-8;
+constexpr double kExp2MaxRelErrorFloat = 2.0e-7;
+constexpr double kLog2MaxAbsError = 2.0e-5;
+constexpr int kSweepPoints = 1 << 20;
+
+static bool errorLine(const char* what, double error, double bound) {
+    bool ok = error < bound;
+    printf("%s %-34s %9.3g (bound %.3g)\n", ok ? "✅" : "❌", what, error, bound);
+    return ok;
+}
+
+// Nanoseconds per call of f over the arguments, best of 5 runs.
+template <typename T, typename F>
+static double nsPerCall(const T* args, int numArgs, F f) {
+    volatile T sink = 0;
+    double best = 0.0;
+    for (int run = 0; run < 5; ++run) {
+        T sum = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < numArgs; ++i)
+            sum += f(args[i]);
+        auto t1 = std::chrono::steady_clock::now();
+        sink = sink + sum;
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / numArgs;
+        if (run == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+// Normalized positive float number i of kSweepPoints, spread evenly over all their bit patterns.
+static float normalizedFloat(int i) {
+    const uint32_t first = 0x00800000, last = 0x7f7fffff;
+    uint32_t bits = first + (uint32_t)(((uint64_t)(last - first) * (uint64_t)i) / (kSweepPoints - 1));
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+// Sweeps the approximations; returns the number of bounds exceeded.
+static int runFastMath() {
+    static double dArgs[kSweepPoints];
+    static float fArgs[kSweepPoints];
+    static float logArgs[kSweepPoints];
+    int failures = 0;
+
+    double expErrD = 0.0, expErrF = 0.0, logErr = 0.0;
+    for (int i = 0; i < kSweepPoints; ++i) {
+        double x = -126.0 + 252.0 * i / (kSweepPoints - 1);
+        dArgs[i] = x;
+        fArgs[i] = (float)x;
+        logArgs[i] = normalizedFloat(i);
+
+        double ref = exp2(x);
+        expErrD = fmax(expErrD, fabs(rosic::fastExp2(x) - ref) / ref);
+        double refF = exp2((double)fArgs[i]);
+        expErrF = fmax(expErrF, fabs((double)rosic::fastExp2(fArgs[i]) - refF) / refF);
+        logErr = fmax(logErr, fabs((double)rosic::fastLog2(logArgs[i]) - log2((double)logArgs[i])));
+    }
+
+    // The mantissa polynomial is where the log error comes from: sweep one octave densely.
+    for (int i = 0; i < kSweepPoints; ++i) {
+        float x = 1.0f + (float)i / kSweepPoints;
+        logErr = fmax(logErr, fabs((double)rosic::fastLog2(x) - log2((double)x)));
+    }
+
+    printf("Error over %d arguments (exp2 in [-126, 126], log2 over all normalized floats):\n",
+           kSweepPoints);
+    failures += !errorLine("fastExp2(double) relative error", expErrD, kExp2MaxRelErrorDouble);
+    failures += !errorLine("fastExp2(float) relative error", expErrF, kExp2MaxRelErrorFloat);
+    failures += !errorLine("fastLog2(float) absolute error", logErr, kLog2MaxAbsError);
+
+    bool clipped = rosic::fastExp2(1000.0) == rosic::fastExp2(126.0)
+                && rosic::fastExp2(-1000.0) == rosic::fastExp2(-126.0)
+                && rosic::fastExp2(1000.0f) == rosic::fastExp2(126.0f)
+                && rosic::fastExp2(-1000.0f) == rosic::fastExp2(-126.0f);
+    printf("%s %s\n", clipped ? "✅" : "❌", "fastExp2 clips its argument to [-126, 126]");
+    failures += !clipped;
+
+    printf("\nTime per call (best of 5 sweeps; host libm, not the target's newlib-nano):\n");
+    printf("   %-22s %6.2f ns   %-14s %6.2f ns\n",
+           "fastExp2(double)", nsPerCall(dArgs, kSweepPoints, [](double x) { return rosic::fastExp2(x); }),
+           "exp2(double)", nsPerCall(dArgs, kSweepPoints, [](double x) { return exp2(x); }));
+    printf("   %-22s %6.2f ns   %-14s %6.2f ns\n",
+           "fastExp2(float)", nsPerCall(fArgs, kSweepPoints, [](float x) { return rosic::fastExp2(x); }),
+           "exp2f(float)", nsPerCall(fArgs, kSweepPoints, [](float x) { return exp2f(x); }));
+    printf("   %-22s %6.2f ns   %-14s %6.2f ns\n",
+           "fastLog2(float)", nsPerCall(logArgs, kSweepPoints, [](float x) { return rosic::fastLog2(x); }),
+           "log2f(float)", nsPerCall(logArgs, kSweepPoints, [](float x) { return log2f(x); }));
+
+    return failures;
+}
+
+// ---- Precision ----
+
+constexpr double kRenderSeconds = 2.0;
+
+struct RenderSetup {
+    Scenario scenario;
+    int oversamplingIndex;
+    int antiAliasIndex;
+};
+
+// The scenarios with notes at every oversampling factor and anti-aliasing mode.
+static const RenderSetup renderSetups[] = {
+    { kScenarioAcid, 0, 0 }, { kScenarioAcid, 1, 0 }, { kScenarioAcid, 1, 1 },
+    { kScenarioAcid, 2, 0 }, { kScenarioAcid, 2, 1 },
+    { kScenarioFilterFm, 0, 0 }, { kScenarioFilterFm, 1, 0 }, { kScenarioFilterFm, 1, 1 },
+    { kScenarioFilterFm, 2, 0 }, { kScenarioFilterFm, 2, 1 },
+};
+constexpr int kNumRenders = ARRAY_SIZE(renderSetups);
+constexpr long kRenderBlocks = (long)(kRenderSeconds * kSampleRate) / kBlockFrames;
+constexpr long kRenderFrames = kRenderBlocks * kBlockFrames;
+
+// Renders one setup from a fresh instance into out (kRenderFrames frames).
+static bool renderSetup(const RenderSetup& setup, float* out) {
+    static float busFrames[kNumBusses * kBlockFrames];
+    Instance inst;
+    if (!createInstance(inst))
+        return false;
+
+    bool filterFm = setup.scenario == kScenarioFilterFm;
+    setParameter(inst, "Oversample", setup.oversamplingIndex);
+    setParameter(inst, "Anti-alias", setup.antiAliasIndex);
+    setParameter(inst, "Cutoff CV", filterFm ? kModulationBus : 0);
+    setParameter(inst, "Filter Coefs", filterFm ? 1 : 0);
+
+    memset(busFrames, 0, sizeof(busFrames));
+    float* modulation = busFrames + (kModulationBus - 1) * kBlockFrames;
+    for (int i = 0; filterFm && i < kBlockFrames; ++i)
+        modulation[i] = sinf(6.2831853f * kModulationHz * i / kSampleRate);
+    const float* output = busFrames + (kOutputBus - 1) * kBlockFrames;
+
+    for (long b = 0; b < kRenderBlocks; ++b) {
+        scriptBlock(inst, setup.scenario, b * kBlockFrames);
+        inst.factory->step(inst.alg, busFrames, kBlockFrames / 4);
+        memcpy(out + b * kBlockFrames, output, sizeof(float) * kBlockFrames);
+    }
+    destroyInstance(inst);
+    return true;
+}
+
+static float* renderAll() {
+    frozenClock = true;
+    float* frames = (float*)malloc(sizeof(float) * kNumRenders * kRenderFrames);
+    for (int r = 0; r < kNumRenders && frames; ++r) {
+        if (!renderSetup(renderSetups[r], frames + r * kRenderFrames)) {
+            free(frames);
+            return nullptr;
+        }
+    }
+    return frames;
+}
+
+static int runRender(const char* path) {
+    float* frames = renderAll();
+    FILE* file = fopen(path, "wb");
+    if (!frames || !file) {
+        fprintf(stderr, "failed to render %s\n", path);
+        return 1;
+    }
+    fwrite(frames, sizeof(float), kNumRenders * kRenderFrames, file);
+    fclose(file);
+    free(frames);
+    return 0;
+}
+
+// Compares this build's renders against a reference file from the other precision; returns the
+// number of renders below minSnr.
+static int runPrecision(const char* path, double minSnr) {
+    size_t count = kNumRenders * kRenderFrames;
+    float* reference = (float*)malloc(sizeof(float) * count);
+    FILE* file = fopen(path, "rb");
+    if (!reference || !file || fread(reference, sizeof(float), count, file) != count) {
+        fprintf(stderr, "cannot read %d renders from %s\n", kNumRenders, path);
+        return 1;
+    }
+    fclose(file);
+
+    float* frames = renderAll();
+    if (!frames) {
+        fprintf(stderr, "failed to render\n");
+        return 1;
+    }
+
+    static const char* const factorNames[] = { "1x", "2x", "4x" };
+    static const char* const antiAliasNames[] = { "elliptic", "halfband" };
+    printf("%s against the reference, %.0f s per render:\n", BENCH_PRECISION, kRenderSeconds);
+    int failures = 0;
+    for (int r = 0; r < kNumRenders; ++r) {
+        const float* x = reference + r * kRenderFrames;
+        const float* y = frames + r * kRenderFrames;
+        double signal = 0.0, noise = 0.0, peak = 0.0;
+        for (long i = 0; i < kRenderFrames; ++i) {
+            double d = (double)y[i] - (double)x[i];
+            signal += (double)x[i] * x[i];
+            noise += d * d;
+            peak = fmax(peak, fabs(d));
+        }
+        double snr = noise > 0.0 ? 10.0 * log10(signal / noise) : 999.0;
+        const RenderSetup& setup = renderSetups[r];
+        char what[64];
+        snprintf(what, sizeof(what), "%s %s%s%s", scenarioNames[setup.scenario],
+                 factorNames[setup.oversamplingIndex], setup.oversamplingIndex ? " " : "",
+                 setup.oversamplingIndex ? antiAliasNames[setup.antiAliasIndex] : "");
+        bool ok = snr >= minSnr;
+        printf("%s %-22s SNR %6.1f dB (limit %.0f)  max diff %.2g V\n", ok ? "✅" : "❌", what, snr,
+               minSnr, peak);
+        failures += !ok;
+    }
+    free(reference);
+    free(frames);
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "budget")) {
+        Instance inst;
+        if (!createInstance(inst)) {
+            fprintf(stderr, "failed to construct the algorithm\n");
+            return 1;
+        }
+        int failures = runBudget(inst, argc - 2, argv + 2);
+        destroyInstance(inst);
+        return failures ? 1 : 0;
+    }
+    if (argc > 1 && !strcmp(argv[1], "arena"))
+        return runArena() ? 1 : 0;
+    if (argc > 1 && !strcmp(argv[1], "fastmath"))
+        return runFastMath() ? 1 : 0;
+    if (argc > 2 && !strcmp(argv[1], "render"))
+        return runRender(argv[2]);
+    if (argc > 3 && !strcmp(argv[1], "precision"))
+        return runPrecision(argv[2], atof(argv[3])) ? 1 : 0;
+
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    int runs = argc > 2 ? atoi(argv[2]) : 5;
+    if (seconds <= 0.0 || runs < 1) {
+        fprintf(stderr, "usage: %s [seconds per run] [runs]\n", argv[0]);
+        return 1;
+    }
+
+    static const int oversamplingFactors[] = { 1, 2, 4 };
+    static const char* const antiAliasNames[] = { "elliptic", "halfband" };   // parameter order
+    const double budgetNs = 1e9 / kSampleRate;
+
+    Instance inst;
+    if (!createInstance(inst)) {
+        fprintf(stderr, "failed to construct the algorithm\n");
+        return 1;
+    }
+
+    for (int s = 0; s < kNumScenarios; ++s) {
+        for (int o = 0; o < (int)ARRAY_SIZE(oversamplingFactors); ++o) {
+            for (int a = 0; a < (int)ARRAY_SIZE(antiAliasNames); ++a) {
+                // At 1x there is no decimation, so both modes run the same code.
+                if (oversamplingFactors[o] == 1 && a > 0)
+                    continue;
+                double ns = runScenario(inst, (Scenario)s, o, a, seconds, runs);
+                printf("{\"bench\":\"nt303\",\"revision\":\"%s\",\"precision\":\"%s\","
+                       "\"scenario\":\"%s\",\"oversampling\":%d,\"antialias\":\"%s\","
+                       "\"ns_per_sample\":%.2f,\"voices_per_core\":%.1f}\n",
+                       BENCH_REVISION, BENCH_PRECISION, scenarioNames[s], oversamplingFactors[o],
+                       antiAliasNames[a], ns, budgetNs / ns);
+                fflush(stdout);
+            }
+        }
+    }
+
+    destroyInstance(inst);
+    return 0;
+}
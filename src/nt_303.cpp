@@ -10,107 +10,46 @@
 #include <new>
 #include <cmath>
 #include <cstddef>
+#ifdef NT_TEST_BUILD
+#include <cassert>
+#endif
 
-constexpr size_t DRAM_HEAP_SIZE = 262144;
-
-#ifndef NT_TEST_BUILD
-namespace {
-    constexpr size_t MIN_BLOCK = 32;
-    constexpr size_t ALIGN = 8;
-    
-    struct BlockHeader {
-        size_t size;
-        BlockHeader* next;
-    };
-    
-    char* heapPool = nullptr;
-    size_t heapSize = 0;
-    size_t heapUsed = 0;
-    BlockHeader* freeList = nullptr;
-    
-    size_t alignUp(size_t n) {
-        return (n + ALIGN - 1) & ~(ALIGN - 1);
-    }
-    
-    void initHeap(void* ptr, size_t size) {
-        heapPool = static_cast<char*>(ptr);
-        heapSize = size;
-        heapUsed = 0;
-        freeList = nullptr;
-    }
-    
-    void* heapAlloc(size_t size) {
-        if (!heapPool) return nullptr;
-        
-        size = alignUp(size + sizeof(BlockHeader));
-        if (size < MIN_BLOCK) size = MIN_BLOCK;
-        
-        BlockHeader** prev = &freeList;
-        BlockHeader* curr = freeList;
-        while (curr) {
-            if (curr->size >= size) {
-                *prev = curr->next;
-                return reinterpret_cast<char*>(curr) + sizeof(BlockHeader);
-            }
-            prev = &curr->next;
-            curr = curr->next;
-        }
-        
-        if (heapUsed + size > heapSize) {
-            return nullptr;
-        }
-        
-        BlockHeader* block = reinterpret_cast<BlockHeader*>(heapPool + heapUsed);
-        block->size = size;
-        block->next = nullptr;
-        heapUsed += size;
-        
-        return reinterpret_cast<char*>(block) + sizeof(BlockHeader);
-    }
-    
-    void heapFree(void* ptr) {
-        if (!ptr || !heapPool) return;
-        char* p = static_cast<char*>(ptr);
-        if (p < heapPool || p >= heapPool + heapSize) return;
-        
-        BlockHeader* block = reinterpret_cast<BlockHeader*>(p - sizeof(BlockHeader));
-        block->next = freeList;
-        freeList = block;
-    }
-}
-
-void* operator new(size_t size) {
-    void* p = heapAlloc(size);
-    if (!p) {
-        while(1) {}
-    }
-    return p;
-}
-
-void* operator new[](size_t size) {
-    return operator new(size);
-}
+#include "nt_heap.h"
+#include "rosic_Memory.h"
 
-void operator delete(void* ptr) noexcept {
-    heapFree(ptr);
-}
+// Arena over the memory of the instance being constructed (or, in initialise(), the static
+// memory); its header sits at the start of that memory. Everything the synth allocates comes from
+// it through rosic's memory functions, in the test build as on hardware, so the DRAM plan is
+// checked against what is really allocated. There is no global operator new: a failed allocation
+// returns null to a caller that checks it, and construct() then marks the instance as out of
+// memory.
+constexpr size_t HEAP_HEADER_SIZE = (sizeof(Arena) + kArenaAlign - 1) & ~(kArenaAlign - 1);
+static Arena* heap = nullptr;
 
-void operator delete[](void* ptr) noexcept {
-    heapFree(ptr);
+static void* heapAlloc(size_t size) {
+    return heap ? arenaAlloc(heap, size) : nullptr;
 }
 
-void operator delete(void* ptr, size_t) noexcept {
-    heapFree(ptr);
+static void heapFree(void* ptr) {
+    if (heap)
+        arenaFree(heap, ptr);
 }
 
-void operator delete[](void* ptr, size_t) noexcept {
-    heapFree(ptr);
+static Arena* initHeap(void* memory, size_t size) {
+    heap = new (memory) Arena;
+    initArena(heap, static_cast<char*>(memory) + HEAP_HEADER_SIZE, size - HEAP_HEADER_SIZE);
+    rosic::setMemoryFunctions(heapAlloc, heapFree);
+    return heap;
 }
-#endif
 
 #include "compat.h"
 #include "rosic_Open303.h"
 #include "nt_soft_takeover.h"
+#include "nt_param_smoother.h"
+#include "nt_event_queue.h"
+#include "nt_voice_alloc.h"
+#include "nt_sequencer.h"
+#include "nt_cv_input.h"
 
 enum {
     kParamOutput,
@@ -128,27 +67,161 @@ enum {
     kParamPitchCV,
     kParamGate,
     kParamAccentCV,
+    kParamModRate,
+    kParamAntiAlias,
+    kParamFilterTable,
+    kParamCutoffCV,
+    kParamFmCV,
     kNumParams
 };
 
+// Sound-page parameters that are ramped in step() instead of being applied in parameterChanged().
+static const uint8_t smoothedParams[] = {
+    kParamCutoff,
+    kParamResonance,
+    kParamEnvMod,
+    kParamDecay,
+    kParamAccent,
+    kParamWaveform,
+    kParamVolume,
+    kParamSlideTime
+};
+constexpr int kNumSmoothed = ARRAY_SIZE(smoothedParams);
+
+// This many parameterChanged() calls between two blocks are a preset being loaded (the NT sets
+// every parameter), not someone turning a knob.
+constexpr int kPresetLoadChanges = kNumParams;
+
+enum {
+    kSpecVoices,
+    kSpecOutputs,
+    kSpecMaxOversampling,
+    kSpecSequencer,
+    kNumSpecs
+};
+
+static const _NT_specification specifications[] = {
+    { .name = "Voices",         .min = 1, .max = kMaxVoices, .def = 1, .type = kNT_typeGeneric },
+    { .name = "Outputs",        .min = 1, .max = kMaxVoices, .def = 1, .type = kNT_typeGeneric },
+    { .name = "Max oversample", .min = 1, .max = 4,          .def = 4, .type = kNT_typeGeneric },
+    { .name = "Sequencer",      .min = 0, .max = 1,          .def = 0, .type = kNT_typeGeneric },
+};
+
+// Sequencer parameters, relative to the first one: root and length, then a Note, Octave,
+// Accent, Slide and Gate per step.
+enum {
+    kSeqParamRoot,
+    kSeqParamLength,
+    kSeqParamSteps
+};
+
+enum {
+    kStepNote,
+    kStepOctave,
+    kStepAccent,
+    kStepSlide,
+    kStepGate,
+    kNumStepParams
+};
+
+constexpr int kNumSeqParams = kSeqParamSteps + kSeqMaxSteps * kNumStepParams;
+
+// What the specifications make of an instance. Voice v plays on output v % numOutputs.
+struct InstanceLayout {
+    int numVoices;
+    int numOutputs;             // no more than there are voices
+    int maxOversampling;        // 1, 2 or 4
+    bool sequencer;
+    int numParameters;          // the static ones, an Output and Output mode per extra output,
+                                // then the sequencer's
+    bool ownParameters;         // any parameters or limits beyond the static ones
+};
+
+static InstanceLayout instanceLayout(const int32_t* specifications) {
+    InstanceLayout layout;
+    layout.numVoices = specifications[kSpecVoices];
+    layout.numOutputs = specifications[kSpecOutputs] < layout.numVoices
+        ? specifications[kSpecOutputs] : layout.numVoices;
+    int maxFactor = specifications[kSpecMaxOversampling];
+    layout.maxOversampling = maxFactor >= 4 ? 4 : (maxFactor >= 2 ? 2 : 1);
+    layout.sequencer = specifications[kSpecSequencer] != 0;
+    layout.numParameters = kNumParams + 2 * (layout.numOutputs - 1);
+    if (layout.sequencer)
+        layout.numParameters += kNumSeqParams;
+    layout.ownParameters = layout.numOutputs > 1 || layout.maxOversampling < 4 || layout.sequencer;
+    return layout;
+}
+
+// The 303 wavetables are read-only once rendered, so all instances share one pair. It lives in
+// the factory's static DRAM, after the heap the FFT renders them with (only in WAVETABLES=runtime
+// builds; ROM builds just point the tables at the const data).
+struct SharedWaveTables {
+    rosic::MipMappedWaveTable saw;
+    rosic::MipMappedWaveTable square;
+};
+
+constexpr size_t SHARED_WAVETABLES_SIZE = (sizeof(SharedWaveTables) + 7) & ~size_t(7);
+#ifdef OPEN303_ROM_WAVETABLES
+constexpr size_t WAVETABLE_HEAP_SIZE = 0;
+#else
+constexpr size_t WAVETABLE_HEAP_SIZE = 196608;   // FFT buffers of both tables + render temporaries
+#endif
+
+static SharedWaveTables* sharedWaveTables = nullptr;
+
 struct _NT303Algorithm : public _NT_algorithm {
-    rosic::Open303 synth;
+    // Each voice holds all its per-sample state (oscillator, filter, envelopes, decimators) in
+    // about 1.4 kB; the voices follow this struct in the instance's SRAM. Everything here is
+    // touched at most once per chunk. Without shared tables (initialise() not called) every voice
+    // renders its own.
+    _NT303Algorithm(SharedWaveTables* tables, void* voiceMemory, int numVoices)
+        : voices(static_cast<rosic::Open303*>(voiceMemory)), numVoices(numVoices) {
+        for (int v = 0; v < numVoices; ++v)
+            new (voices + v) rosic::Open303(tables ? &tables->saw : NULL,
+                                            tables ? &tables->square : NULL);
+    }
+    
+    // With one voice, notes are handled by the synth itself (legato slides, note priority); with
+    // more, every note gets a voice of its own. Gate CV always plays voice 0.
+    rosic::Open303* voices;
+    int numVoices;
+    VoiceAllocator voiceAlloc;
     
-    bool prevGate;
-    bool cvNoteActive;
-    int currentCVNote;
-    int lastMidiChannel;
+    float cvPitch;          // pitch CV last passed to voice 0, kNoPitch after a MIDI note
+    bool prevGate;          // the gate CV holds a note on voice 0
     
-    float smoothCutoff;
-    float smoothResonance;
-    float smoothDecay;
+    SmoothedParam smooth[kNumSmoothed];
+    uint32_t rampingMask;   // bit n set while smooth[n] is ramping
+    uint8_t paramChanges;   // parameterChanged() calls since the last step()
+    bool snapParams;        // the next step() jumps to the parameter values instead of ramping
     
     float lastSampleRate;
     
+    // MIDI events are stamped with their arrival time relative to the start of the last step()
+    // and rendered at that offset in the next one.
+    EventQueue midiQueue;
+    uint32_t blockStartCycles;
+    uint32_t cyclesPerFrame;
+    int lastNumFrames;
+    
     SoftTakeoverState uiState;
+    
+    // The busses of the block step() is rendering; the outputs are looked up in them.
+    float* busFrames;
+    int numFrames;
+    int numOutputs;
+    
+    StepSequencer* sequencer;   // null unless the Sequencer specification is on
+    
+    Arena* heap;            // this instance's DRAM
+    bool outOfMemory;       // construct() could not get its memory: stay silent
 };
 
 static char const * const enumStringsOversampling[] = { "1x", "2x", "4x" };
+static char const * const enumStringsModRate[] = { "Audio", "8 smp", "16 smp", "32 smp" };
+static const int modRateValues[] = { 1, 8, 16, 32 };
+static char const * const enumStringsAntiAlias[] = { "Elliptic", "Half-band" };
+static char const * const enumStringsFilterTable[] = { "Computed", "Table" };
 
 static const _NT_parameter parameters[] = {
     NT_PARAMETER_AUDIO_OUTPUT_WITH_MODE("Output", 1, 13)
@@ -165,6 +238,11 @@ static const _NT_parameter parameters[] = {
     NT_PARAMETER_CV_INPUT("Pitch CV", 0, 0)
     NT_PARAMETER_CV_INPUT("Gate", 0, 0)
     NT_PARAMETER_CV_INPUT("Accent CV", 0, 0)
+    { .name = "Mod Rate",   .min = 0,    .max = 3,     .def = 1,    .unit = kNT_unitEnum,    .scaling = kNT_scalingNone, .enumStrings = enumStringsModRate },
+    { .name = "Anti-alias", .min = 0,    .max = 1,     .def = 1,    .unit = kNT_unitEnum,    .scaling = kNT_scalingNone, .enumStrings = enumStringsAntiAlias },
+    { .name = "Filter Coefs", .min = 0,  .max = 1,     .def = 0,    .unit = kNT_unitEnum,    .scaling = kNT_scalingNone, .enumStrings = enumStringsFilterTable },
+    NT_PARAMETER_CV_INPUT("Cutoff CV", 0, 0)
+    NT_PARAMETER_CV_INPUT("FM CV", 0, 0)
 };
 
 static const uint8_t pageSound[] = {
@@ -176,7 +254,10 @@ static const uint8_t pageSound[] = {
     kParamWaveform,
     kParamVolume,
     kParamSlideTime,
-    kParamOversampling
+    kParamOversampling,
+    kParamAntiAlias,
+    kParamModRate,
+    kParamFilterTable
 };
 
 static const uint8_t pageRouting[] = {
@@ -185,7 +266,9 @@ static const uint8_t pageRouting[] = {
     kParamMidiChannel,
     kParamPitchCV,
     kParamGate,
-    kParamAccentCV
+    kParamAccentCV,
+    kParamCutoffCV,
+    kParamFmCV
 };
 
 static const _NT_parameterPage pages[] = {
@@ -198,51 +281,278 @@ static const _NT_parameterPages parameterPages = {
     .pages = pages,
 };
 
+// Parameters 0/1 are the first output; each further output appends its pair after kNumParams.
+static const char* const outputNames[kMaxVoices] = {
+    "Output", "Output 2", "Output 3", "Output 4", "Output 5", "Output 6", "Output 7", "Output 8"
+};
+static const char* const outputModeNames[kMaxVoices] = {
+    "Output mode", "Output 2 mode", "Output 3 mode", "Output 4 mode",
+    "Output 5 mode", "Output 6 mode", "Output 7 mode", "Output 8 mode"
+};
+
+static int outputParam(int output) {
+    return output == 0 ? kParamOutput : kNumParams + 2 * (output - 1);
+}
+
+// The sequencer's parameters follow the last output pair.
+static int seqParamBase(int numOutputs) {
+    return kNumParams + 2 * (numOutputs - 1);
+}
+
+static char const * const enumStringsNote[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+static char const * const enumStringsOffOn[] = { "Off", "On" };
+
+// Root and length, then the parameters of one step; the steps differ only in name and default.
+static const _NT_parameter seqParameters[kSeqParamSteps + kNumStepParams] = {
+    { .name = "Seq Root",   .min = 0,    .max = 127,   .def = 36,   .unit = kNT_unitMIDINote, .scaling = kNT_scalingNone, .enumStrings = NULL },
+    { .name = "Seq Length", .min = 1,    .max = kSeqMaxSteps, .def = kSeqMaxSteps, .unit = kNT_unitNone, .scaling = kNT_scalingNone, .enumStrings = NULL },
+    { .name = "Note",       .min = 0,    .max = 11,    .def = 0,    .unit = kNT_unitEnum,     .scaling = kNT_scalingNone, .enumStrings = enumStringsNote },
+    { .name = "Octave",     .min = -1,   .max = 1,     .def = 0,    .unit = kNT_unitNone,     .scaling = kNT_scalingNone, .enumStrings = NULL },
+    { .name = "Accent",     .min = 0,    .max = 1,     .def = 0,    .unit = kNT_unitEnum,     .scaling = kNT_scalingNone, .enumStrings = enumStringsOffOn },
+    { .name = "Slide",      .min = 0,    .max = 1,     .def = 0,    .unit = kNT_unitEnum,     .scaling = kNT_scalingNone, .enumStrings = enumStringsOffOn },
+    { .name = "Gate",       .min = 0,    .max = 1,     .def = 1,    .unit = kNT_unitEnum,     .scaling = kNT_scalingNone, .enumStrings = enumStringsOffOn },
+};
+
+#define SEQ_STEP_NAMES(n) #n " Note", #n " Octave", #n " Accent", #n " Slide", #n " Gate"
+static const char* const seqStepNames[kSeqMaxSteps * kNumStepParams] = {
+    SEQ_STEP_NAMES(1),  SEQ_STEP_NAMES(2),  SEQ_STEP_NAMES(3),  SEQ_STEP_NAMES(4),
+    SEQ_STEP_NAMES(5),  SEQ_STEP_NAMES(6),  SEQ_STEP_NAMES(7),  SEQ_STEP_NAMES(8),
+    SEQ_STEP_NAMES(9),  SEQ_STEP_NAMES(10), SEQ_STEP_NAMES(11), SEQ_STEP_NAMES(12),
+    SEQ_STEP_NAMES(13), SEQ_STEP_NAMES(14), SEQ_STEP_NAMES(15), SEQ_STEP_NAMES(16)
+};
+#undef SEQ_STEP_NAMES
+
+// Default pattern, an acid line over the root: note, octave, accent, slide and gate per step.
+static const int8_t defaultPattern[kSeqMaxSteps][kNumStepParams] = {
+    { 0,  0, 1, 0, 1 }, { 0, 0, 0, 0, 1 }, { 0, 1, 0, 1, 1 }, { 3, 0, 0, 0, 1 },
+    { 0,  0, 0, 0, 0 }, { 0, 0, 1, 0, 1 }, { 7, 0, 0, 1, 1 }, { 5, 0, 0, 0, 1 },
+    { 0,  0, 0, 0, 1 }, { 0, 0, 0, 0, 0 }, { 0, 1, 1, 1, 1 }, { 10, 0, 0, 0, 1 },
+    { 0,  0, 0, 0, 1 }, { 3, 0, 1, 0, 1 }, { 0, 0, 0, 0, 0 }, { 10, -1, 0, 1, 1 },
+};
+
+// The Sequencer page (root and length) and a page per half of the steps.
+static const char* const seqPageNames[] = { "Sequencer", "Steps 1-8", "Steps 9-16" };
+constexpr int kNumSeqPages = ARRAY_SIZE(seqPageNames);
+static const uint8_t seqPageStart[kNumSeqPages + 1] = {
+    kSeqParamRoot, kSeqParamSteps, kSeqParamSteps + kSeqMaxSteps / 2 * kNumStepParams, kNumSeqParams
+};
+
+// Parameters and pages of an instance whose layout differs from the static ones. They follow
+// _NT303Algorithm in its SRAM, the pages first and then layout.numParameters parameters.
+struct InstancePages {
+    uint8_t routing[ARRAY_SIZE(pageRouting) + 2 * (kMaxVoices - 1)];
+    _NT_parameterPage page[ARRAY_SIZE(pages) + kNumSeqPages];
+    _NT_parameterPages pageSet;
+};
+
+// With the Sequencer specification on, this follows the parameters.
+struct InstanceSequencer {
+    StepSequencer state;
+    uint8_t pageParams[kNumSeqParams];
+};
+
+// SRAM of one instance: the algorithm, its voices, then its own parameters and sequencer.
+static size_t instanceSramSize(const InstanceLayout& layout) {
+    size_t size = sizeof(_NT303Algorithm) + layout.numVoices * sizeof(rosic::Open303);
+    if (layout.ownParameters)
+        size += sizeof(InstancePages) + layout.numParameters * sizeof(_NT_parameter);
+    if (layout.sequencer)
+        size += sizeof(InstanceSequencer);
+    return size;
+}
+
+static void setupSequencerParameters(_NT_parameter* params) {
+    params[kSeqParamRoot] = seqParameters[kSeqParamRoot];
+    params[kSeqParamLength] = seqParameters[kSeqParamLength];
+    for (int i = 0; i < kSeqMaxSteps * kNumStepParams; ++i) {
+        _NT_parameter& param = params[kSeqParamSteps + i];
+        param = seqParameters[kSeqParamSteps + i % kNumStepParams];
+        param.name = seqStepNames[i];
+        param.def = defaultPattern[i / kNumStepParams][i % kNumStepParams];
+    }
+}
+
+static void setupInstanceParameters(_NT303Algorithm* alg, void* memory, const InstanceLayout& layout) {
+    InstancePages* own = new (memory) InstancePages;
+    _NT_parameter* params = reinterpret_cast<_NT_parameter*>(own + 1);
+    
+    for (int p = 0; p < kNumParams; ++p)
+        params[p] = parameters[p];
+    int maxIndex = layout.maxOversampling == 4 ? 2 : layout.maxOversampling - 1;
+    params[kParamOversampling].max = maxIndex;
+    if (params[kParamOversampling].def > maxIndex)
+        params[kParamOversampling].def = maxIndex;
+    
+    for (int o = 1; o < layout.numOutputs; ++o) {
+        _NT_parameter* output = params + outputParam(o);
+        output[0] = parameters[kParamOutput];
+        output[0].name = outputNames[o];
+        output[0].def = parameters[kParamOutput].def + o;
+        output[1] = parameters[kParamOutputMode];
+        output[1].name = outputModeNames[o];
+    }
+    
+    int n = 0;
+    for (int o = 0; o < layout.numOutputs; ++o) {
+        own->routing[n++] = outputParam(o);
+        own->routing[n++] = outputParam(o) + 1;
+    }
+    for (int i = 2; i < (int)ARRAY_SIZE(pageRouting); ++i)
+        own->routing[n++] = pageRouting[i];
+    
+    own->page[0] = pages[0];
+    own->page[1] = pages[1];
+    own->page[1].numParams = n;
+    own->page[1].params = own->routing;
+    own->pageSet.numPages = ARRAY_SIZE(pages);
+    own->pageSet.pages = own->page;
+    
+    if (layout.sequencer) {
+        int base = seqParamBase(layout.numOutputs);
+        setupSequencerParameters(params + base);
+        
+        InstanceSequencer* seq = new (params + layout.numParameters) InstanceSequencer;
+        initSequencer(&seq->state);
+        for (int i = 0; i < kNumSeqParams; ++i)
+            seq->pageParams[i] = base + i;
+        for (int pg = 0; pg < kNumSeqPages; ++pg) {
+            _NT_parameterPage& page = own->page[own->pageSet.numPages++];
+            page = pages[0];
+            page.name = seqPageNames[pg];
+            page.numParams = seqPageStart[pg + 1] - seqPageStart[pg];
+            page.params = seq->pageParams + seqPageStart[pg];
+        }
+        alg->sequencer = &seq->state;
+    }
+    
+    alg->parameters = params;
+    alg->parameterPages = &own->pageSet;
+}
+
+void calculateStaticRequirements(_NT_staticRequirements& req) {
+    req.dram = SHARED_WAVETABLES_SIZE + HEAP_HEADER_SIZE + WAVETABLE_HEAP_SIZE;
+}
+
+void initialise(_NT_staticMemoryPtrs& ptrs, const _NT_staticRequirements& req) {
+    initHeap(ptrs.dram, HEAP_HEADER_SIZE + WAVETABLE_HEAP_SIZE);
+    
+    sharedWaveTables = new (ptrs.dram + HEAP_HEADER_SIZE + WAVETABLE_HEAP_SIZE) SharedWaveTables();
+    sharedWaveTables->saw.setWaveform(rosic::MipMappedWaveTable::SAW303);
+    sharedWaveTables->square.setWaveform(rosic::MipMappedWaveTable::SQUARE303);
+    
+#ifdef NT_TEST_BUILD
+    // WAVETABLE_HEAP_SIZE must cover everything the render allocated.
+    assert(heap->peak <= heap->size);
+#endif
+    // Tables rendered without their buffers are unusable; every instance then renders its own.
+    if (heap->failed)
+        sharedWaveTables = nullptr;
+}
+
+// Filter table slots in the instance's DRAM: one per oversampling factor up to the maximum.
+static int filterTableSize(const InstanceLayout& layout) {
+    return rosic::TeeBeeFilterFast::getCoefficientTableSize(
+        rosic::Open303::getNumFilterTableSlots(layout.maxOversampling));
+}
+
+// DRAM of one instance: exactly the heap blocks construct() allocates. Only the filter tables
+// depend on the oversampling factor; the decimators and filters are fixed-size members of the
+// voices. All voices read the filter tables of voice 0.
+static size_t instanceDramSize(const InstanceLayout& layout) {
+    size_t size = HEAP_HEADER_SIZE + arenaBlockSize(filterTableSize(layout));
+    // Without shared tables every voice allocates (and in runtime builds renders) its own pair.
+    if (!sharedWaveTables)
+        size += layout.numVoices * (2 * arenaBlockSize(sizeof(rosic::MipMappedWaveTable)) + WAVETABLE_HEAP_SIZE);
+    return size;
+}
+
 void calculateRequirements(_NT_algorithmRequirements& req, const int32_t* specifications) {
-    req.numParameters = ARRAY_SIZE(parameters);
-    req.sram = sizeof(_NT303Algorithm);
-    req.dram = DRAM_HEAP_SIZE;
+    InstanceLayout layout = instanceLayout(specifications);
+    req.numParameters = layout.numParameters;
+    req.sram = instanceSramSize(layout);
+    req.dram = instanceDramSize(layout);
     req.dtc = 0;
     req.itc = 0;
 }
 
+// Switches voice 0's filter tables on or off; the other voices read them and follow.
+static void applyFilterTable(_NT303Algorithm* pThis, bool useTable) {
+    pThis->voices[0].setUseFilterTable(useTable);
+    for (int v = 1; v < pThis->numVoices; ++v)
+        pThis->voices[v].shareFilterTable(&pThis->voices[0]);
+}
+
 _NT_algorithm* construct(const _NT_algorithmMemoryPtrs& ptrs,
                          const _NT_algorithmRequirements& req,
                          const int32_t* specifications) {
-#ifndef NT_TEST_BUILD
-    initHeap(ptrs.dram, DRAM_HEAP_SIZE);
-#endif
+    Arena* heap = initHeap(ptrs.dram, req.dram);
     
-    _NT303Algorithm* alg = new (ptrs.sram) _NT303Algorithm();
+    InstanceLayout layout = instanceLayout(specifications);
+    int numVoices = layout.numVoices;
+    uint8_t* voiceMemory = ptrs.sram + sizeof(_NT303Algorithm);
+    _NT303Algorithm* alg = new (ptrs.sram) _NT303Algorithm(sharedWaveTables, voiceMemory, numVoices);
+    alg->heap = heap;
+    alg->numOutputs = layout.numOutputs;
     
     alg->parameters = parameters;
     alg->parameterPages = &parameterPages;
+    alg->sequencer = nullptr;
+    if (layout.ownParameters)
+        setupInstanceParameters(alg, voiceMemory + numVoices * sizeof(rosic::Open303), layout);
     
-    alg->synth.setSampleRate(NT_globals.sampleRate);
+    for (int v = 0; v < numVoices; ++v)
+        alg->voices[v].setSampleRate(NT_globals.sampleRate);
     alg->lastSampleRate = NT_globals.sampleRate;
     
     alg->prevGate = false;
-    alg->cvNoteActive = false;
-    alg->currentCVNote = 60;
-    alg->lastMidiChannel = 0;
+    alg->cvPitch = kNoPitch;
+    // With more than one voice the sequencer keeps voice 0, so its slide steps stay legato on one
+    // voice, and MIDI notes are spread over the others.
+    initVoiceAllocator(&alg->voiceAlloc, layout.sequencer && numVoices > 1 ? 1 : 0, numVoices);
     
-    alg->smoothCutoff = (float)parameters[kParamCutoff].def;
-    alg->smoothResonance = (float)parameters[kParamResonance].def;
-    alg->smoothDecay = (float)parameters[kParamDecay].def;
+    for (int n = 0; n < kNumSmoothed; ++n)
+        initSmoothedParam(&alg->smooth[n], (float)parameters[smoothedParams[n]].def);
+    alg->rampingMask = 0;
+    alg->paramChanges = 0;
+    alg->snapParams = true;
     
-    initSoftTakeover(&alg->uiState);
+    initEventQueue(&alg->midiQueue);
+    alg->blockStartCycles = NT_getCpuCycleCount();
+    alg->cyclesPerFrame = 0;
+    alg->lastNumFrames = 0;
     
-    alg->synth.setCutoff(parameters[kParamCutoff].def);
-    alg->synth.setResonance(parameters[kParamResonance].def);
-    alg->synth.setEnvMod(parameters[kParamEnvMod].def);
-    alg->synth.setDecay(parameters[kParamDecay].def);
-    alg->synth.setAccent(parameters[kParamAccent].def);
-    alg->synth.setWaveform(parameters[kParamWaveform].def / 100.0);
-    alg->synth.setVolume(parameters[kParamVolume].def);
-    alg->synth.setSlideTime(parameters[kParamSlideTime].def);
+    initSoftTakeover(&alg->uiState);
     
     static const int oversamplingValues[] = {1, 2, 4};
-    alg->synth.setOversampling(oversamplingValues[parameters[kParamOversampling].def]);
+    for (int v = 0; v < numVoices; ++v) {
+        rosic::Open303& synth = alg->voices[v];
+        synth.setMaxOversampling(layout.maxOversampling);
+        synth.setCutoff(parameters[kParamCutoff].def);
+        synth.setResonance(parameters[kParamResonance].def);
+        synth.setEnvMod(parameters[kParamEnvMod].def);
+        synth.setDecay(parameters[kParamDecay].def);
+        synth.setAccent(parameters[kParamAccent].def);
+        synth.setWaveform(parameters[kParamWaveform].def / 100.0);
+        synth.setVolume(parameters[kParamVolume].def);
+        synth.setSlideTime(parameters[kParamSlideTime].def);
+        
+        synth.setOversampling(oversamplingValues[alg->parameters[kParamOversampling].def]);
+        synth.setControlRate(modRateValues[parameters[kParamModRate].def]);
+        synth.setAntiAliasMode(parameters[kParamAntiAlias].def);
+    }
+    // The filter table lives in this instance's DRAM whether or not it is switched on, so it can be
+    // built later from parameterChanged().
+    alg->voices[0].setFilterTableMemory(heapAlloc(filterTableSize(layout)),
+                                        rosic::Open303::getNumFilterTableSlots(layout.maxOversampling));
+    
+    alg->outOfMemory = heap->failed;
+    if (!alg->outOfMemory)
+        applyFilterTable(alg, parameters[kParamFilterTable].def != 0);
+    
+#ifdef NT_TEST_BUILD
+    // instanceDramSize() must cover everything construct() allocated.
+    assert(HEAP_HEADER_SIZE + heap->peak <= req.dram);
+#endif
     
     return alg;
 }
@@ -250,124 +560,411 @@ _NT_algorithm* construct(const _NT_algorithmMemoryPtrs& ptrs,
 void parameterChanged(_NT_algorithm* self, int p) {
     _NT303Algorithm* pThis = (_NT303Algorithm*)self;
     
+    if (++pThis->paramChanges >= kPresetLoadChanges) {
+        pThis->paramChanges = kPresetLoadChanges;
+        pThis->snapParams = true;
+    }
+    
     switch (p) {
-        case kParamCutoff:
-            pThis->synth.setCutoff(pThis->v[kParamCutoff]);
-            break;
-        case kParamResonance:
-            pThis->synth.setResonance(pThis->v[kParamResonance]);
+        // The smoothedParams are picked up by step().
+        case kParamOversampling: {
+            static const int oversamplingValues[] = {1, 2, 4};
+            for (int v = 0; v < pThis->numVoices; ++v)
+                pThis->voices[v].setOversampling(oversamplingValues[pThis->v[kParamOversampling]]);
             break;
-        case kParamEnvMod:
-            pThis->synth.setEnvMod(pThis->v[kParamEnvMod]);
+        }
+        case kParamModRate:
+            for (int v = 0; v < pThis->numVoices; ++v)
+                pThis->voices[v].setControlRate(modRateValues[pThis->v[kParamModRate]]);
             break;
-        case kParamDecay:
-            pThis->synth.setDecay(pThis->v[kParamDecay]);
+        case kParamAntiAlias:
+            for (int v = 0; v < pThis->numVoices; ++v)
+                pThis->voices[v].setAntiAliasMode(pThis->v[kParamAntiAlias]);
             break;
-        case kParamAccent:
-            pThis->synth.setAccent(pThis->v[kParamAccent]);
+        case kParamFilterTable:
+            if (!pThis->outOfMemory)
+                applyFilterTable(pThis, pThis->v[kParamFilterTable] != 0);
             break;
-        case kParamWaveform:
-            pThis->synth.setWaveform(pThis->v[kParamWaveform] / 100.0);
+    }
+}
+
+// Frames rendered per processBlock() call. Ramping parameters and CV are pushed to the synth at
+// this rate.
+constexpr int kRenderChunk = kCvChunkFrames;
+constexpr float kOutputGain = 5.0f;
+constexpr float kRampSeconds = 0.01f;
+
+static void applySmoothedParam(_NT303Algorithm* pThis, int param, float value) {
+    for (int v = 0; v < pThis->numVoices; ++v) {
+        rosic::Open303& synth = pThis->voices[v];
+        switch (param) {
+            case kParamCutoff:    synth.setCutoff(value);           break;
+            case kParamResonance: synth.setResonance(value);        break;
+            case kParamEnvMod:    synth.setEnvMod(value);           break;
+            case kParamDecay:     synth.setDecay(value);            break;
+            case kParamAccent:    synth.setAccent(value);           break;
+            case kParamWaveform:  synth.setWaveform(value / 100.0); break;
+            case kParamVolume:    synth.setVolume(value);           break;
+            case kParamSlideTime: synth.setSlideTime(value);        break;
+        }
+    }
+}
+
+// Moves all ramping parameters on by numFrames and pushes their new values to the synth.
+static void advanceRamps(_NT303Algorithm* pThis, int numFrames) {
+    uint32_t mask = pThis->rampingMask;
+    for (int n = 0; mask; ++n, mask >>= 1) {
+        if (!(mask & 1))
+            continue;
+        if (!advanceSmoothedParam(&pThis->smooth[n], numFrames))
+            pThis->rampingMask &= ~(1u << n);
+        applySmoothedParam(pThis, smoothedParams[n], pThis->smooth[n].current);
+    }
+}
+
+// Jumps all ramping parameters to their targets.
+static void settleRamps(_NT303Algorithm* pThis) {
+    if (!pThis->rampingMask)
+        return;
+    for (int n = 0; n < kNumSmoothed; ++n) {
+        if (settleSmoothedParam(&pThis->smooth[n]))
+            applySmoothedParam(pThis, smoothedParams[n], pThis->smooth[n].current);
+    }
+    pThis->rampingMask = 0;
+}
+
+static bool allVoicesIdle(const _NT303Algorithm* pThis) {
+    for (int v = 0; v < pThis->numVoices; ++v) {
+        if (!pThis->voices[v].isIdle())
+            return false;
+    }
+    return true;
+}
+
+static float* outputBus(const _NT303Algorithm* pThis, int output) {
+    return pThis->busFrames + (pThis->v[outputParam(output)] - 1) * pThis->numFrames;
+}
+
+static bool replacesBus(const _NT303Algorithm* pThis, int output) {
+    return pThis->v[outputParam(output) + 1];
+}
+
+// Clears frames [start, start + numFrames) of the outputs that replace their bus.
+static void clearOutputs(_NT303Algorithm* pThis, int start, int numFrames) {
+    for (int o = 0; o < pThis->numOutputs; ++o) {
+        if (!replacesBus(pThis, o))
+            continue;
+        float* out = outputBus(pThis, o) + start;
+        for (int i = 0; i < numFrames; ++i)
+            out[i] = 0.0f;
+    }
+}
+
+// Frame start of the bus a CV input parameter selects, null when it is not patched.
+static const float* cvInputBus(const _NT303Algorithm* pThis, int param, int start) {
+    if (pThis->v[param] <= 0)
+        return nullptr;
+    return pThis->busFrames + (pThis->v[param] - 1) * pThis->numFrames + start;
+}
+
+// Renders frames [start, start + numFrames) of all outputs.
+static void renderFrames(_NT303Algorithm* pThis, int start, int numFrames) {
+    if (numFrames <= 0)
+        return;
+    
+    // Cutoff CV and FM CV are added per frame inside the voices' render loop (1V/oct); the one that
+    // is not patched reads zeros, so the modulated kernel has no branches on them.
+    static const float noModulation[kRenderChunk] = { 0 };
+    const float* cutoffMod = cvInputBus(pThis, kParamCutoffCV, start);
+    const float* pitchMod = cvInputBus(pThis, kParamFmCV, start);
+    bool modulated = cutoffMod || pitchMod;
+    if (!cutoffMod)
+        cutoffMod = noModulation;
+    if (!pitchMod)
+        pitchMod = noModulation;
+    
+    // The sounding voices render the chunk one after the other, each from its own state,
+    // and are summed per output; sleeping ones cost a flag test.
+    float mix[kMaxVoices][kRenderChunk];
+    float buffer[kRenderChunk];
+    bool sounding[kMaxVoices] = { false };
+    for (int v = 0; v < pThis->numVoices; ++v) {
+        if (pThis->voices[v].isIdle())
+            continue;
+        int o = v % pThis->numOutputs;
+        float* out = sounding[o] ? buffer : mix[o];
+        if (modulated)
+            pThis->voices[v].processBlock(out, numFrames, cutoffMod, pitchMod);
+        else
+            pThis->voices[v].processBlock(out, numFrames);
+        if (!sounding[o]) {
+            sounding[o] = true;
+        } else {
+            for (int i = 0; i < numFrames; ++i)
+                mix[o][i] += buffer[i];
+        }
+    }
+    
+    for (int o = 0; o < pThis->numOutputs; ++o) {
+        float* out = outputBus(pThis, o) + start;
+        bool replace = replacesBus(pThis, o);
+        if (!sounding[o]) {
+            if (replace) {
+                for (int i = 0; i < numFrames; ++i)
+                    out[i] = 0.0f;
+            }
+        } else if (replace) {
+            for (int i = 0; i < numFrames; ++i)
+                out[i] = mix[o][i] * kOutputGain;
+        } else {
+            for (int i = 0; i < numFrames; ++i)
+                out[i] += mix[o][i] * kOutputGain;
+        }
+    }
+}
+
+// The CV inputs of the block being rendered (gate null when none is patched; pitch and accent
+// are only followed with a gate) and the analysis of the span the current chunk is in.
+struct CvInputs {
+    const float* gate;
+    const float* pitch;
+    const float* accent;
+    int spanStart;
+    CvSpan span;
+};
+
+// Follows pitch and accent CV at the start of chunk k of the span while the gate holds a note.
+// Pitch only goes to the synth when it has moved by more than the tolerance.
+static void applyChunkCV(_NT303Algorithm* pThis, const CvInputs& cv, int k) {
+    if (!pThis->prevGate)
+        return;
+    
+    if (cv.pitch) {
+        float moved = cv.span.pitch[k] - pThis->cvPitch;
+        if (moved > kPitchTolerance || moved < -kPitchTolerance) {
+            pThis->voices[0].setOscillatorFrequency(cv.span.freq[k]);
+            pThis->cvPitch = cv.span.pitch[k];
+        }
+    }
+    if (cv.accent)
+        pThis->voices[0].setAccentGain(cv.span.accent[k]);
+}
+
+static void noteOn(_NT303Algorithm* pThis, int note, int velocity) {
+    pThis->cvPitch = kNoPitch;
+    if (pThis->numVoices == 1) {
+        pThis->voices[0].noteOn(note, velocity);
+        return;
+    }
+    // A voice that still holds a note (retriggered or stolen) lets go of it first, so it
+    // retriggers instead of sliding and cannot fall back to the old note later.
+    int v = allocateVoice(&pThis->voiceAlloc, note);
+    pThis->voices[v].allNotesOff();
+    pThis->voices[v].noteOn(note, velocity);
+}
+
+static void noteOff(_NT303Algorithm* pThis, int note) {
+    if (pThis->numVoices == 1) {
+        pThis->voices[0].noteOn(note, 0);
+        return;
+    }
+    int v = releaseVoice(&pThis->voiceAlloc, note);
+    if (v >= 0)
+        pThis->voices[v].noteOn(note, 0);
+}
+
+static void applyMidiEvent(_NT303Algorithm* pThis, const TimedEvent& event) {
+    uint8_t b1 = event.data1;
+    uint8_t b2 = event.data2;
+    
+    // The sequencer's notes bypass the allocator: a slide step's note-on arrives while the
+    // previous note is still held, and only on the same voice does that slide instead of retrigger.
+    if (event.sequencer) {
+        if ((event.status & 0xf0) == 0x90)
+            pThis->cvPitch = kNoPitch;
+        pThis->voices[0].noteOn(b1, (event.status & 0xf0) == 0x90 ? b2 : 0);
+        return;
+    }
+    
+    switch (event.status & 0xf0) {
+        case 0x90:
+            if (b2 > 0) {
+                noteOn(pThis, b1, b2);
+                break;
+            }
+            noteOff(pThis, b1);
             break;
-        case kParamVolume:
-            pThis->synth.setVolume(pThis->v[kParamVolume]);
+        case 0x80:
+            noteOff(pThis, b1);
             break;
-        case kParamSlideTime:
-            pThis->synth.setSlideTime(pThis->v[kParamSlideTime]);
+        case 0xB0:
+            if (b1 == 120 || b1 == 123) {
+                for (int v = 0; v < pThis->numVoices; ++v)
+                    pThis->voices[v].allNotesOff();
+                releaseAllVoices(&pThis->voiceAlloc);
+            }
             break;
-        case kParamOversampling: {
-            static const int oversamplingValues[] = {1, 2, 4};
-            pThis->synth.setOversampling(oversamplingValues[pThis->v[kParamOversampling]]);
+        case 0xE0: {
+            int bend = ((b2 << 7) | b1) - 8192;
+            double semitones = bend * 2.0 / 8192.0;
+            for (int v = 0; v < pThis->numVoices; ++v)
+                pThis->voices[v].setPitchBend(semitones);
             break;
         }
-        case kParamMidiChannel:
-            pThis->lastMidiChannel = pThis->v[kParamMidiChannel] - 1;
-            break;
     }
 }
 
+// Renders frames [start, end) of one chunk, splitting at its gate edges so CV notes start on the
+// exact frame.
+static void renderGated(_NT303Algorithm* pThis, int start, int end, const CvInputs& cv) {
+    int runStart = start;
+    if (cv.gate) {
+        int chunk = (start - cv.spanStart) / kRenderChunk;
+        int chunkStart = cv.spanStart + chunk * kRenderChunk;
+        uint32_t edges = cv.span.edges[chunk] & ((1u << (end - chunkStart)) - (1u << (start - chunkStart)));
+        
+        while (edges) {
+            int i = chunkStart + __builtin_ctz(edges);
+            edges &= edges - 1;
+            
+            renderFrames(pThis, runStart, i - runStart);
+            runStart = i;
+            
+            if (!pThis->prevGate) {
+                bool accent = cv.accent && cv.accent[i] > kAccentVolts;
+                pThis->voices[0].noteOn(60, accent ? 127 : 80);
+                if (cv.pitch) {
+                    pThis->voices[0].setOscillatorFrequency(cvPitchToFreq(cv.pitch[i]));
+                    pThis->cvPitch = cv.pitch[i];
+                }
+                if (cv.accent)
+                    pThis->voices[0].setAccentGain(cvAccentGain(cv.accent[i]));
+            } else {
+                pThis->voices[0].allNotesOff();
+            }
+            
+            pThis->prevGate = !pThis->prevGate;
+        }
+    }
+    
+    renderFrames(pThis, runStart, end - runStart);
+}
+
 void step(_NT_algorithm* self, float* busFrames, int numFramesBy4) {
     _NT303Algorithm* pThis = (_NT303Algorithm*)self;
     int numFrames = numFramesBy4 * 4;
     
+    uint32_t now = NT_getCpuCycleCount();
+    if (pThis->lastNumFrames > 0)
+        pThis->cyclesPerFrame = (now - pThis->blockStartCycles) / pThis->lastNumFrames;
+    pThis->blockStartCycles = now;
+    pThis->lastNumFrames = numFrames;
+    
+    // Only the events that arrived before this block; later ones carry offsets for the next.
+    uint32_t numEvents = pendingEvents(&pThis->midiQueue);
+    
     if (NT_globals.sampleRate != pThis->lastSampleRate) {
-        pThis->synth.setSampleRate(NT_globals.sampleRate);
+        for (int v = 0; v < pThis->numVoices; ++v)
+            pThis->voices[v].setSampleRate(NT_globals.sampleRate);
         pThis->lastSampleRate = NT_globals.sampleRate;
     }
     
-    const float* pitchCV = nullptr;
-    const float* gateCV = nullptr;
-    const float* accentCV = nullptr;
+    CvInputs cv;
+    cv.gate = nullptr;
+    cv.pitch = nullptr;
+    cv.accent = nullptr;
+    cv.spanStart = 0;
     
     if (pThis->v[kParamPitchCV] > 0)
-        pitchCV = busFrames + (pThis->v[kParamPitchCV] - 1) * numFrames;
+        cv.pitch = busFrames + (pThis->v[kParamPitchCV] - 1) * numFrames;
     if (pThis->v[kParamGate] > 0)
-        gateCV = busFrames + (pThis->v[kParamGate] - 1) * numFrames;
+        cv.gate = busFrames + (pThis->v[kParamGate] - 1) * numFrames;
     if (pThis->v[kParamAccentCV] > 0)
-        accentCV = busFrames + (pThis->v[kParamAccentCV] - 1) * numFrames;
+        cv.accent = busFrames + (pThis->v[kParamAccentCV] - 1) * numFrames;
+    
+    pThis->busFrames = busFrames;
+    pThis->numFrames = numFrames;
     
-    float* out = busFrames + (pThis->v[kParamOutput] - 1) * numFrames;
-    bool replace = pThis->v[kParamOutputMode];
+    if (pThis->outOfMemory) {
+        clearOutputs(pThis, 0, numFrames);
+        return;
+    }
     
-    float targetCutoff = (float)pThis->v[kParamCutoff];
-    float targetRes = (float)pThis->v[kParamResonance];
-    float targetDecay = (float)pThis->v[kParamDecay];
+    // Only edits while the instance runs are ramped; after construct() or a preset load the
+    // parameters start out at their values.
+    int rampFrames = (int)(pThis->lastSampleRate * kRampSeconds);
+    for (int n = 0; n < kNumSmoothed; ++n) {
+        if (setSmoothedTarget(&pThis->smooth[n], (float)pThis->v[smoothedParams[n]], rampFrames))
+            pThis->rampingMask |= 1u << n;
+    }
+    if (pThis->snapParams)
+        settleRamps(pThis);
+    pThis->snapParams = false;
+    pThis->paramChanges = 0;
     
-    constexpr float smoothCoeff = 0.001f;
+    // A sleeping voice can only be woken by MIDI or a gate edge, so without queued events or a
+    // rising gate there is nothing to render. Settle the ramps so the next note starts settled.
+    bool gateQuiet = !cv.gate || (!pThis->prevGate && gateCandidates(cv.gate, numFrames, false) == 0);
+    if (allVoicesIdle(pThis) && gateQuiet && numEvents == 0) {
+        settleRamps(pThis);
+        clearOutputs(pThis, 0, numFrames);
+        return;
+    }
     
-    for (int i = 0; i < numFrames; ++i) {
-        pThis->smoothCutoff += smoothCoeff * (targetCutoff - pThis->smoothCutoff);
-        pThis->smoothResonance += smoothCoeff * (targetRes - pThis->smoothResonance);
-        pThis->smoothDecay += smoothCoeff * (targetDecay - pThis->smoothDecay);
+    for (int start = 0; start < numFrames; start += kRenderChunk) {
+        int end = start + kRenderChunk;
+        if (end > numFrames)
+            end = numFrames;
         
-        if ((i & 7) == 0) {
-            pThis->synth.setCutoff(pThis->smoothCutoff);
-            pThis->synth.setResonance(pThis->smoothResonance);
-            pThis->synth.setDecay(pThis->smoothDecay);
-        }
-
-        if (gateCV) {
-            bool gateHigh = pThis->prevGate 
-                ? (gateCV[i] >= 1.0f)
-                : (gateCV[i] > 1.5f);
-            
-            if (gateHigh && !pThis->prevGate) {
-                bool accent = accentCV && accentCV[i] > 2.5f;
-                int velocity = accent ? 127 : 80;
-                pThis->synth.noteOn(60, velocity);
-                pThis->cvNoteActive = true;
-            }
-            
-            if (gateHigh && pitchCV) {
-                float freq = cvToFreq(pitchCV[i]);
-                pThis->synth.setOscillatorFrequency(freq);
-            }
-            
-            if (gateHigh && accentCV) {
-                float accentLevel = (accentCV[i] - 2.5f) / 2.5f;
-                if (accentLevel < 0.0f) accentLevel = 0.0f;
-                if (accentLevel > 1.0f) accentLevel = 1.0f;
-                pThis->synth.setAccentGain(accentLevel * 0.5);
+        if (pThis->rampingMask)
+            advanceRamps(pThis, end - start);
+        
+        if (cv.gate) {
+            if (start % kCvSpanFrames == 0) {
+                int spanFrames = numFrames - start < kCvSpanFrames ? numFrames - start : kCvSpanFrames;
+                analyseCvSpan(&cv.span, cv.gate + start, cv.pitch ? cv.pitch + start : nullptr,
+                              cv.accent ? cv.accent + start : nullptr, spanFrames, pThis->prevGate);
+                cv.spanStart = start;
             }
-            
-            if (!gateHigh && pThis->prevGate) {
-                pThis->synth.allNotesOff();
-                pThis->cvNoteActive = false;
+            applyChunkCV(pThis, cv, (start - cv.spanStart) / kRenderChunk);
+        }
+        
+        // MIDI events split the chunk so they land on their own frame. Events stamped beyond this
+        // block (it may be shorter than the last one) are applied on its last frame.
+        int pos = start;
+        while (pos < end) {
+            int eventFrame = end;
+            while (numEvents > 0) {
+                const TimedEvent& event = frontEvent(&pThis->midiQueue);
+                eventFrame = event.offset < numFrames ? event.offset : numFrames - 1;
+                if (eventFrame > pos)
+                    break;
+                applyMidiEvent(pThis, event);
+                popEvent(&pThis->midiQueue);
+                --numEvents;
+                eventFrame = end;
             }
+            if (eventFrame > end)
+                eventFrame = end;
             
-            pThis->prevGate = gateHigh;
+            renderGated(pThis, pos, eventFrame, cv);
+            pos = eventFrame;
         }
-        
-        float sample = static_cast<float>(pThis->synth.getSample());
-        sample *= 5.0f;
-        
-        if (replace)
-            out[i] = sample;
-        else
-            out[i] += sample;
     }
 }
 
+// Frame of the next block that a message arriving now is rendered at: as far into it as the
+// message came into the current one, measured by the CPU cycles per frame of the last block.
+static uint16_t eventOffset(const _NT303Algorithm* pThis) {
+    uint32_t offset = 0;
+    if (pThis->cyclesPerFrame > 0) {
+        offset = (NT_getCpuCycleCount() - pThis->blockStartCycles) / pThis->cyclesPerFrame;
+        if (offset >= (uint32_t)pThis->lastNumFrames)
+            offset = pThis->lastNumFrames - 1;
+    }
+    return (uint16_t)offset;
+}
+
 void midiMessage(_NT_algorithm* self, uint8_t b0, uint8_t b1, uint8_t b2) {
     _NT303Algorithm* pThis = (_NT303Algorithm*)self;
     
@@ -379,24 +976,55 @@ void midiMessage(_NT_algorithm* self, uint8_t b0, uint8_t b1, uint8_t b2) {
     }
     
     int status = b0 & 0xf0;
+    if (status != 0x80 && status != 0x90 && status != 0xB0 && status != 0xE0)
+        return;
     
-    switch (status) {
-        case 0x90:
-            pThis->synth.noteOn(b1, b2);
+    TimedEvent event = { eventOffset(pThis), b0, b1, b2, false };
+    pushEvent(&pThis->midiQueue, event);
+}
+
+static SeqStep sequencerStep(const _NT303Algorithm* pThis, int index) {
+    const int16_t* seq = pThis->v + seqParamBase(pThis->numOutputs);
+    const int16_t* step = seq + kSeqParamSteps + index * kNumStepParams;
+    int note = seq[kSeqParamRoot] + step[kStepNote] + 12 * step[kStepOctave];
+    if (note < 0) note = 0;
+    if (note > 127) note = 127;
+    return { note, step[kStepAccent] != 0, step[kStepSlide] != 0, step[kStepGate] != 0 };
+}
+
+// MIDI clock, Start, Continue and Stop drive the sequencer. The notes of a tick are queued at the
+// tick's own offset, so steps land on their exact frame like played MIDI notes.
+void midiRealtime(_NT_algorithm* self, uint8_t byte) {
+    _NT303Algorithm* pThis = (_NT303Algorithm*)self;
+    StepSequencer* seq = pThis->sequencer;
+    if (!seq)
+        return;
+    
+    SeqEvent events[kSeqMaxEvents];
+    int numEvents = 0;
+    switch (byte) {
+        case 0xF8: {
+            int length = pThis->v[seqParamBase(pThis->numOutputs) + kSeqParamLength];
+            numEvents = seqClock(seq, sequencerStep(pThis, seqStepIndex(seq, length)), events);
             break;
-        case 0x80:
-            pThis->synth.noteOn(b1, 0);
+        }
+        case 0xFA:
+            numEvents = seqStart(seq, events);
             break;
-        case 0xB0:
-            if (b1 == 120 || b1 == 123)
-                pThis->synth.allNotesOff();
+        case 0xFB:
+            seqContinue(seq);
             break;
-        case 0xE0: {
-            int bend = ((b2 << 7) | b1) - 8192;
-            double semitones = bend * 2.0 / 8192.0;
-            pThis->synth.setPitchBend(semitones);
+        case 0xFC:
+            numEvents = seqStop(seq, events);
             break;
-        }
+    }
+    
+    if (numEvents == 0)
+        return;
+    uint16_t offset = eventOffset(pThis);
+    for (int i = 0; i < numEvents; ++i) {
+        TimedEvent event = { offset, events[i].status, events[i].data1, events[i].data2, true };
+        pushEvent(&pThis->midiQueue, event);
     }
 }
 
@@ -435,6 +1063,11 @@ bool draw(_NT_algorithm* self) {
     
     NT_drawText(128, 20, "NT-303", 15, kNT_textCentre, kNT_textLarge);
     
+    if (pThis->outOfMemory) {
+        NT_drawText(128, 44, "Out of memory", 15, kNT_textCentre, kNT_textNormal);
+        return true;
+    }
+    
     decrementDisplayTimeout(&pThis->uiState);
     
     if (isDisplayActive(&pThis->uiState)) {
@@ -499,10 +1132,6 @@ void customUi(_NT_algorithm* self, const _NT_uiData& data) {
         PotResult result = processPot(&pThis->uiState, pot, data, potConfigs[pot]);
         if (result.changed) {
             NT_setParameterFromUi(algIndex, result.paramIdx + offset, (int16_t)result.paramValue);
-            
-            if (result.paramIdx == kParamCutoff) pThis->smoothCutoff = result.paramValue;
-            else if (result.paramIdx == kParamResonance) pThis->smoothResonance = result.paramValue;
-            else if (result.paramIdx == kParamDecay) pThis->smoothDecay = result.paramValue;
         }
     }
     
@@ -525,16 +1154,16 @@ static const _NT_factory factory = {
     .guid = NT_MULTICHAR('T', 'h', 'T', 'B'),
     .name = "NT-303",
     .description = "TB-303 Bass Synth (Open303)",
-    .numSpecifications = 0,
-    .specifications = NULL,
-    .calculateStaticRequirements = NULL,
-    .initialise = NULL,
+    .numSpecifications = ARRAY_SIZE(specifications),
+    .specifications = specifications,
+    .calculateStaticRequirements = calculateStaticRequirements,
+    .initialise = initialise,
     .calculateRequirements = calculateRequirements,
     .construct = construct,
     .parameterChanged = parameterChanged,
     .step = step,
     .draw = draw,
-    .midiRealtime = NULL,
+    .midiRealtime = midiRealtime,
     .midiMessage = midiMessage,
     .tags = kNT_tagInstrument,
     .hasCustomUi = hasCustomUi,
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "rosic_FastMath.h"
+
+// Block front end for the Gate, Pitch and Accent CV inputs. One pass over a span of frames finds
+// the gate edges and samples pitch and accent at the start of every render chunk, so the render
+// loop only reads results. Reading pitch per chunk instead of per frame is intended: the synth's
+// pitch slew (at least 0.2 ms, 12 ms by default) smooths out the 8-frame steps, and audio-rate
+// pitch modulation goes through the FM CV input, which is read per frame. The loops have no calls
+// and no data-dependent branches (pitch goes through the branch-free rosic::fastExp2()), which
+// lets the compiler unroll or vectorize them.
+
+constexpr int kCvChunkFrames = 8;           // frames per render chunk
+constexpr int kCvSpanFrames = 128;          // frames analysed per pass
+constexpr int kCvMaxChunks = kCvSpanFrames / kCvChunkFrames;
+
+constexpr float kGateOnVolts = 1.5f;        // Schmitt trigger thresholds
+constexpr float kGateOffVolts = 1.0f;
+constexpr float kAccentVolts = 2.5f;
+
+// Pitch CV changes smaller than this (volts, here a cent) are not passed on to the synth.
+constexpr float kPitchTolerance = 1.0f / 1200.0f;
+constexpr float kNoPitch = -1000.0f;        // no pitch pushed yet: the next one always is
+
+struct CvSpan {
+    int numChunks;
+    uint8_t edges[kCvMaxChunks];    // bit i: the gate changes state at frame i of the chunk
+    float pitch[kCvMaxChunks];      // pitch CV at the chunk's first frame
+    float freq[kCvMaxChunks];       // its oscillator frequency
+    float accent[kCvMaxChunks];     // accent gain at the chunk's first frame
+};
+
+// 1V/oct with 0V at C4 (A4 = 440 Hz at 0.75 V).
+inline float cvPitchToFreq(float cv) {
+    return 440.0f * rosic::fastExp2(cv - 0.75f);
+}
+
+// Accent gain for an accent CV: none up to kAccentVolts, 0.5 at twice that.
+inline float cvAccentGain(float cv) {
+    float level = (cv - kAccentVolts) / kAccentVolts;
+    level = level < 0.0f ? 0.0f : level;
+    level = level > 1.0f ? 1.0f : level;
+    return level * 0.5f;
+}
+
+// Number of frames past the threshold a gate in state high would cross. Most spans have none,
+// and then there is no edge to look for.
+inline int gateCandidates(const float* gate, int numFrames, bool high) {
+    int count = 0;
+    if (high) {
+        for (int i = 0; i < numFrames; ++i)
+            count += gate[i] < kGateOffVolts;
+    } else {
+        for (int i = 0; i < numFrames; ++i)
+            count += gate[i] > kGateOnVolts;
+    }
+    return count;
+}
+
+// Analyses up to kCvSpanFrames frames, with the gate in state high before the first. pitch and
+// accent may be null.
+inline void analyseCvSpan(CvSpan* span, const float* gate, const float* pitch, const float* accent,
+                          int numFrames, bool high) {
+    int numChunks = (numFrames + kCvChunkFrames - 1) / kCvChunkFrames;
+    span->numChunks = numChunks;
+
+    for (int k = 0; k < numChunks; ++k)
+        span->edges[k] = 0;
+    bool anyEdge = gateCandidates(gate, numFrames, high) > 0;
+    if (anyEdge) {
+        bool state = high;
+        for (int i = 0; i < numFrames; ++i) {
+            bool next = state ? gate[i] >= kGateOffVolts : gate[i] > kGateOnVolts;
+            span->edges[i / kCvChunkFrames] |= (uint8_t)((next != state) << (i % kCvChunkFrames));
+            state = next;
+        }
+    }
+
+    // Pitch and accent only matter while a note is held.
+    if (!high && !anyEdge)
+        return;
+
+    if (pitch) {
+        for (int k = 0; k < numChunks; ++k)
+            span->pitch[k] = pitch[k * kCvChunkFrames];
+        for (int k = 0; k < numChunks; ++k)
+            span->freq[k] = cvPitchToFreq(span->pitch[k]);
+    }
+
+    if (accent) {
+        for (int k = 0; k < numChunks; ++k)
+            span->accent[k] = cvAccentGain(accent[k * kCvChunkFrames]);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Fixed-size single-producer/single-consumer ring of timestamped MIDI events. midiMessage()
+// pushes, step() pops while rendering. There is no allocation and no locking; when the ring is
+// full, new events are dropped and counted.
+
+constexpr uint32_t kEventQueueSize = 64;   // must be a power of two
+
+struct TimedEvent {
+    uint16_t offset;    // frame within the block that renders the event
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    bool sequencer;     // from the built-in sequencer, which plays voice 0 only
+};
+
+struct EventQueue {
+    TimedEvent events[kEventQueueSize];
+    std::atomic<uint32_t> head;    // next event to read, written by the consumer
+    std::atomic<uint32_t> tail;    // next free slot, written by the producer
+    uint32_t dropped;
+};
+
+inline void initEventQueue(EventQueue* q) {
+    q->head.store(0, std::memory_order_relaxed);
+    q->tail.store(0, std::memory_order_relaxed);
+    q->dropped = 0;
+}
+
+// Returns false (and counts the event as dropped) if the ring is full.
+inline bool pushEvent(EventQueue* q, const TimedEvent& event) {
+    uint32_t tail = q->tail.load(std::memory_order_relaxed);
+    if (tail - q->head.load(std::memory_order_acquire) >= kEventQueueSize) {
+        q->dropped++;
+        return false;
+    }
+    q->events[tail & (kEventQueueSize - 1)] = event;
+    q->tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// Number of events that can be read. Take this once per block so that events pushed while the
+// block renders are left for the next one.
+inline uint32_t pendingEvents(const EventQueue* q) {
+    return q->tail.load(std::memory_order_acquire) - q->head.load(std::memory_order_relaxed);
+}
+
+// The oldest event; only valid while pendingEvents() is non-zero.
+inline const TimedEvent& frontEvent(const EventQueue* q) {
+    return q->events[q->head.load(std::memory_order_relaxed) & (kEventQueueSize - 1)];
+}
+
+inline void popEvent(EventQueue* q) {
+    q->head.store(q->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Arena allocator over one fixed block of memory (an instance's DRAM). New blocks come from a bump
+// pointer; freed blocks go onto segregated free lists by power-of-two size class and are reused
+// as they are, without splitting or coalescing. A request only looks at the heads of its own size
+// class and the next one, so alloc and free are O(1) and a block is always less than four times
+// the size the request needs (arenaBlockSize(); `nt_303_bench arena` checks this). When the
+// memory runs out the request fails and the arena is marked failed; what that means for the
+// instance is up to the caller.
+
+constexpr size_t kArenaAlign = 8;
+constexpr size_t kArenaMinBlock = 32;
+constexpr int kArenaNumClasses = 24;    // class c: blocks of 2^c up to 2^(c+1)-1 bytes
+
+struct ArenaBlock {
+    size_t size;            // including this header
+    ArenaBlock* next;       // free list link while the block is free
+};
+
+struct Arena {
+    char* base;
+    size_t size;
+    size_t top;             // bytes taken from the bump pointer
+    size_t used;            // bytes in live blocks
+    size_t peak;            // most the arena was asked to hold, including failed requests
+    size_t freeBytes;       // bytes waiting on the free lists
+    uint32_t numAllocs;
+    uint32_t numFailures;
+    bool failed;
+    ArenaBlock* freeLists[kArenaNumClasses];
+};
+
+// Arena space taken by an allocation of size bytes.
+inline size_t arenaBlockSize(size_t size) {
+    size = (size + sizeof(ArenaBlock) + kArenaAlign - 1) & ~(kArenaAlign - 1);
+    return size < kArenaMinBlock ? kArenaMinBlock : size;
+}
+
+inline int arenaSizeClass(size_t blockSize) {
+    int c = 31 - __builtin_clz((uint32_t)blockSize);
+    return c < kArenaNumClasses ? c : kArenaNumClasses - 1;
+}
+
+inline void initArena(Arena* a, void* memory, size_t size) {
+    a->base = static_cast<char*>(memory);
+    a->size = size;
+    a->top = 0;
+    a->used = 0;
+    a->peak = 0;
+    a->freeBytes = 0;
+    a->numAllocs = 0;
+    a->numFailures = 0;
+    a->failed = false;
+    for (int c = 0; c < kArenaNumClasses; ++c)
+        a->freeLists[c] = nullptr;
+}
+
+// Returns nullptr (and marks the arena failed) when the request does not fit.
+inline void* arenaAlloc(Arena* a, size_t size) {
+    size_t blockSize = arenaBlockSize(size);
+
+    int c = arenaSizeClass(blockSize);
+    for (int k = c; k < c + 2 && k < kArenaNumClasses; ++k) {
+        ArenaBlock* block = a->freeLists[k];
+        if (block && block->size >= blockSize) {
+            a->freeLists[k] = block->next;
+            a->freeBytes -= block->size;
+            a->used += block->size;
+            a->numAllocs++;
+            return reinterpret_cast<char*>(block) + sizeof(ArenaBlock);
+        }
+    }
+
+    if (a->top + blockSize > a->size) {
+        if (a->top + blockSize > a->peak)
+            a->peak = a->top + blockSize;
+        a->numFailures++;
+        a->failed = true;
+        return nullptr;
+    }
+
+    ArenaBlock* block = reinterpret_cast<ArenaBlock*>(a->base + a->top);
+    block->size = blockSize;
+    block->next = nullptr;
+    a->top += blockSize;
+    a->used += blockSize;
+    a->numAllocs++;
+    if (a->top > a->peak)
+        a->peak = a->top;
+    return reinterpret_cast<char*>(block) + sizeof(ArenaBlock);
+}
+
+// Ignores pointers that are not from this arena.
+inline void arenaFree(Arena* a, void* ptr) {
+    char* p = static_cast<char*>(ptr);
+    if (!p || p < a->base + sizeof(ArenaBlock) || p >= a->base + a->top)
+        return;
+
+    ArenaBlock* block = reinterpret_cast<ArenaBlock*>(p - sizeof(ArenaBlock));
+    int c = arenaSizeClass(block->size);
+    block->next = a->freeLists[c];
+    a->freeLists[c] = block;
+    a->used -= block->size;
+    a->freeBytes += block->size;
+}
+
+// Share of the bump-allocated space that sits unused on the free lists (0..1).
+inline float arenaFragmentation(const Arena* a) {
+    return a->top ? (float)a->freeBytes / (float)a->top : 0.0f;
+}
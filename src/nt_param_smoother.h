@@ -0,0 +1,50 @@
+#pragma once
+
+// Linear parameter ramps for the audio thread. A ramp runs from the current value to the latest
+// target over a fixed number of frames; when the target moves mid-ramp, a new ramp starts from
+// wherever the value is. Settled parameters cost nothing but the target comparison.
+
+struct SmoothedParam {
+    float current;
+    float target;
+    float increment;
+    int remaining;
+};
+
+inline void initSmoothedParam(SmoothedParam* p, float value) {
+    p->current = value;
+    p->target = value;
+    p->increment = 0.0f;
+    p->remaining = 0;
+}
+
+// Starts a ramp towards target if it differs from the current one. Returns true while ramping.
+inline bool setSmoothedTarget(SmoothedParam* p, float target, int rampFrames) {
+    if (target != p->target) {
+        p->target = target;
+        if (rampFrames < 1) rampFrames = 1;
+        p->remaining = rampFrames;
+        p->increment = (target - p->current) / rampFrames;
+    }
+    return p->remaining > 0;
+}
+
+// Moves the ramp on by numFrames. Returns false once the target has been reached.
+inline bool advanceSmoothedParam(SmoothedParam* p, int numFrames) {
+    if (numFrames >= p->remaining) {
+        p->current = p->target;
+        p->remaining = 0;
+        return false;
+    }
+    p->current += p->increment * numFrames;
+    p->remaining -= numFrames;
+    return true;
+}
+
+// Jumps to the target. Returns true if the value changed.
+inline bool settleSmoothedParam(SmoothedParam* p) {
+    bool changed = p->current != p->target;
+    p->current = p->target;
+    p->remaining = 0;
+    return changed;
+}
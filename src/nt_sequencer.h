@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+
+// 16-step acid sequencer driven by MIDI clock (24 ticks per quarter note, a step every 6). It
+// renders nothing itself: each clock tick it is given turns into the note events due on that
+// tick, which the caller queues at the tick's frame offset like any other MIDI message. A slide
+// step holds its note into the next one, whose note-on comes before the old note-off so the
+// synth sees legato playing and slides.
+
+constexpr int kSeqMaxSteps = 16;
+constexpr uint32_t kSeqTicksPerStep = 6;
+constexpr uint32_t kSeqGateTicks = 3;       // a step without slide is released halfway through
+constexpr int kSeqMaxEvents = 2;            // note events one tick can produce
+
+struct SeqStep {
+    int note;       // MIDI note
+    bool accent;
+    bool slide;
+    bool gate;      // false: rest
+};
+
+struct SeqEvent {
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+};
+
+struct StepSequencer {
+    bool running;
+    uint32_t tick;          // clock ticks since Start
+    int heldNote;           // note the sequencer is sounding, -1 if none
+    bool holdSlide;         // heldNote slides into the next step
+};
+
+inline void initSequencer(StepSequencer* s) {
+    s->running = false;
+    s->tick = 0;
+    s->heldNote = -1;
+    s->holdSlide = false;
+}
+
+// Step that the next clock tick falls into.
+inline int seqStepIndex(const StepSequencer* s, int length) {
+    return (int)((s->tick / kSeqTicksPerStep) % (uint32_t)length);
+}
+
+inline int seqRelease(StepSequencer* s, SeqEvent* events) {
+    if (s->heldNote < 0)
+        return 0;
+    events[0] = { 0x80, (uint8_t)s->heldNote, 0 };
+    s->heldNote = -1;
+    s->holdSlide = false;
+    return 1;
+}
+
+// MIDI Start: the next tick plays the first step.
+inline int seqStart(StepSequencer* s, SeqEvent* events) {
+    s->running = true;
+    s->tick = 0;
+    return seqRelease(s, events);
+}
+
+// MIDI Continue: resumes from where Stop left off.
+inline void seqContinue(StepSequencer* s) {
+    s->running = true;
+}
+
+inline int seqStop(StepSequencer* s, SeqEvent* events) {
+    s->running = false;
+    return seqRelease(s, events);
+}
+
+// Advances by one clock tick, given the step it falls into (see seqStepIndex()). Writes the note
+// events due on this tick and returns how many there are.
+inline int seqClock(StepSequencer* s, const SeqStep& step, SeqEvent* events) {
+    if (!s->running)
+        return 0;
+
+    int n = 0;
+    uint32_t phase = s->tick % kSeqTicksPerStep;
+    if (phase == 0) {
+        int prev = s->heldNote;
+        if (step.gate && step.note == prev) {
+            // Sliding into the same note just keeps it sounding.
+        } else if (step.gate) {
+            events[n++] = { 0x90, (uint8_t)step.note, (uint8_t)(step.accent ? 127 : 80) };
+            if (prev >= 0)
+                events[n++] = { 0x80, (uint8_t)prev, 0 };
+            s->heldNote = step.note;
+        } else {
+            n = seqRelease(s, events);
+        }
+        s->holdSlide = step.gate && step.slide;
+    } else if (phase == kSeqGateTicks && !s->holdSlide) {
+        n = seqRelease(s, events);
+    }
+
+    s->tick++;
+    return n;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+
+// Note-to-voice assignment for the polyphonic mode. The bookkeeping is one array per field, so a
+// search only walks the field it compares. A new note takes the voice that already plays it,
+// else the free voice released longest ago, else it steals the voice started longest ago. The
+// voices below firstVoice are left out (the sequencer keeps voice 0 to itself).
+
+constexpr int kMaxVoices = 8;
+
+struct VoiceAllocator {
+    int firstVoice;
+    int numVoices;
+    uint32_t clock;                 // advances on every note-on and note-off
+    int8_t note[kMaxVoices];        // note held on the voice, -1 once it is released
+    uint32_t onTime[kMaxVoices];    // clock at the voice's last note-on
+    uint32_t offTime[kMaxVoices];   // clock at the voice's last release
+};
+
+inline void initVoiceAllocator(VoiceAllocator* a, int firstVoice, int numVoices) {
+    a->firstVoice = firstVoice;
+    a->numVoices = numVoices;
+    a->clock = 0;
+    for (int v = 0; v < kMaxVoices; ++v) {
+        a->note[v] = -1;
+        a->onTime[v] = 0;
+        a->offTime[v] = 0;
+    }
+}
+
+// Returns the voice for a new note, which may still be holding another one (when it is stolen).
+inline int allocateVoice(VoiceAllocator* a, int note) {
+    uint32_t now = ++a->clock;
+    int voice = -1;
+
+    for (int v = a->firstVoice; v < a->numVoices; ++v) {
+        if (a->note[v] == note)
+            voice = v;
+    }
+
+    if (voice < 0) {
+        uint32_t oldest = 0;
+        for (int v = a->firstVoice; v < a->numVoices; ++v) {
+            if (a->note[v] < 0 && now - a->offTime[v] >= oldest) {
+                oldest = now - a->offTime[v];
+                voice = v;
+            }
+        }
+    }
+
+    if (voice < 0) {
+        uint32_t oldest = 0;
+        for (int v = a->firstVoice; v < a->numVoices; ++v) {
+            if (now - a->onTime[v] >= oldest) {
+                oldest = now - a->onTime[v];
+                voice = v;
+            }
+        }
+    }
+
+    a->note[voice] = (int8_t)note;
+    a->onTime[voice] = now;
+    return voice;
+}
+
+// Returns the voice that was holding the note, or -1 if none was (it may have been stolen).
+inline int releaseVoice(VoiceAllocator* a, int note) {
+    for (int v = a->firstVoice; v < a->numVoices; ++v) {
+        if (a->note[v] == note) {
+            a->note[v] = -1;
+            a->offTime[v] = ++a->clock;
+            return v;
+        }
+    }
+    return -1;
+}
+
+inline void releaseAllVoices(VoiceAllocator* a) {
+    uint32_t now = ++a->clock;
+    for (int v = a->firstVoice; v < a->numVoices; ++v) {
+        if (a->note[v] >= 0) {
+            a->note[v] = -1;
+            a->offTime[v] = now;
+        }
+    }
+}
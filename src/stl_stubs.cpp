@@ -1,6 +1,7 @@
 /*
  * Minimal math stubs for bare-metal ARM (newlib-nano lacks these)
  * Used by: BiquadFilter (sinh), MipMappedWaveTable (tanh), FFT (atan2)
+ * With OPEN303_ROM_WAVETABLES the wavetables are rendered on the host, so only sinh is needed.
  */
 
 #include <cmath>
@@ -14,6 +15,7 @@ extern "C" double sinh(double x) {
     return (ex - 1.0/ex) * 0.5;
 }
 
+#ifndef OPEN303_ROM_WAVETABLES
 extern "C" double tanh(double x) {
     double ex = exp(2.0 * x);
     return (ex - 1.0) / (ex + 1.0);
@@ -27,3 +29,4 @@ extern "C" double atan2(double y, double x) {
     if (x == 0 && y < 0) return -M_PI / 2;
     return 0;
 }
+#endif
@@ -0,0 +1,123 @@
+/*
+ * NT-303 wavetable generator
+ *
+ * Runs on the build host. Renders the mip-maps of the two 303 waveforms with the regular
+ * (FFT-based) MipMappedWaveTable and writes them as const arrays, so the plugin can link them
+ * in as read-only data instead of rendering them in every construct() (see
+ * rosic_WaveTableData.h). Run by the Makefile whenever the Open303 patches change.
+ *
+ * With --int16 the samples are written as 16-bit integers with one scale factor per level
+ * (OPEN303_INT16_WAVETABLES), and the signal-to-noise ratio of every quantized level is printed.
+ *
+ * Usage: gen_wavetables [--int16] <output.cpp>
+ */
+
+#include "rosic_MipMappedWaveTable.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using rosic::MipMappedWaveTable;
+
+// Name of the array in rosic_WaveTableData.h and the waveform it holds.
+struct WaveTableSpec {
+    const char* name;
+    int waveform;
+};
+
+static const WaveTableSpec waveTables[] = {
+    { "romWaveTableSaw303", MipMappedWaveTable::SAW303 },
+    { "romWaveTableSquare303", MipMappedWaveTable::SQUARE303 },
+};
+
+// ~107 kB, so it is allocated; only once main() has given the library malloc() to allocate with.
+static MipMappedWaveTable* table = nullptr;
+
+static void writeFloatTable(FILE* out, const WaveTableSpec& spec) {
+    const int numTables = MipMappedWaveTable::getNumStoredTables();
+    const int length = MipMappedWaveTable::getTableLength() + 4;
+
+    fprintf(out, "\nconst float rosic::%s[%d][%d] = {\n", spec.name, numTables, length);
+    for (int t = 0; t < numTables; ++t) {
+        const float* samples = table->getTable(t);
+        fprintf(out, "  {");
+        for (int i = 0; i < length; ++i)
+            fprintf(out, "%s%.8ef,", (i % 8) ? " " : "\n    ", samples[i]);
+        fprintf(out, "\n  },\n");
+    }
+    fprintf(out, "};\n");
+}
+
+// Scales every level to the full 16-bit range and reports the SNR of the rounding against the
+// float level.
+static void writeInt16Table(FILE* out, const WaveTableSpec& spec) {
+    const int numTables = MipMappedWaveTable::getNumStoredTables();
+    const int length = MipMappedWaveTable::getTableLength() + 4;
+    float scales[64];
+
+    fprintf(out, "\nconst int16_t rosic::%s[%d][%d] = {\n", spec.name, numTables, length);
+    for (int t = 0; t < numTables; ++t) {
+        const float* samples = table->getTable(t);
+        float peak = 0.0f;
+        for (int i = 0; i < length; ++i)
+            peak = fmaxf(peak, fabsf(samples[i]));
+        scales[t] = peak > 0.0f ? peak / 32767.0f : 1.0f;
+
+        double signal = 0.0, noise = 0.0;
+        fprintf(out, "  {");
+        for (int i = 0; i < length; ++i) {
+            long q = lrintf(samples[i] / scales[t]);
+            double error = (double)samples[i] - (double)q * scales[t];
+            signal += (double)samples[i] * samples[i];
+            noise += error * error;
+            fprintf(out, "%s%ld,", (i % 16) ? " " : "\n    ", q);
+        }
+        fprintf(out, "\n  },\n");
+        printf("%-22s level %2d  peak %.4f  SNR %6.1f dB\n", spec.name, t, peak,
+               noise > 0.0 ? 10.0 * log10(signal / noise) : INFINITY);
+    }
+    fprintf(out, "};\n");
+
+    fprintf(out, "\nconst float rosic::%sScale[%d] = {", spec.name, numTables);
+    for (int t = 0; t < numTables; ++t)
+        fprintf(out, "%s%.8ef,", (t % 4) ? " " : "\n  ", scales[t]);
+    fprintf(out, "\n};\n");
+}
+
+int main(int argc, char** argv) {
+    bool int16 = argc == 3 && !strcmp(argv[1], "--int16");
+    if (argc != 2 && !int16) {
+        fprintf(stderr, "usage: %s [--int16] <output.cpp>\n", argv[0]);
+        return 1;
+    }
+    rosic::setMemoryFunctions(malloc, free);
+    table = rosic::newObject<MipMappedWaveTable>();
+    if (!table) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+
+    const char* path = argv[argc - 1];
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return 1;
+    }
+
+    fprintf(out, "// Generated by tools/gen_wavetables.cpp - do not edit.\n\n");
+    fprintf(out, "#include \"rosic_WaveTableData.h\"\n");
+    for (const WaveTableSpec& spec : waveTables) {
+        table->setWaveform(spec.waveform);
+        if (int16)
+            writeInt16Table(out, spec);
+        else
+            writeFloatTable(out, spec);
+    }
+
+    if (fclose(out) != 0) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}